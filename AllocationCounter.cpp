@@ -0,0 +1,111 @@
+#include "AllocationCounter.h"
+#include <cstdlib>
+#include <new>
+
+#ifdef PSOR_ALLOCATION_COUNTER_ENABLED
+
+static thread_local std::size_t allocationCount = 0;
+
+// Sanitizers bring their own malloc, GCC flags them with __SANITIZE_*__ and Clang through __has_feature
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_HWADDRESS__) || defined(__SANITIZE_THREAD__)
+#define PSOR_SANITIZER_MALLOC
+#endif
+#if defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(hwaddress_sanitizer) || __has_feature(thread_sanitizer) || \
+    __has_feature(memory_sanitizer)
+#define PSOR_SANITIZER_MALLOC
+#endif
+#endif
+
+#if defined(__GLIBC__) && !defined(PSOR_SANITIZER_MALLOC)
+
+// Counted at malloc, which operator new and Eigen's aligned allocations both go through. The allocator itself is
+// glibc's, so memory is still released by its free.
+extern "C" {
+
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+
+void* malloc(std::size_t size) {
+    allocationCount++;
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) {
+    allocationCount++;
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, std::size_t size) {
+    allocationCount++;
+    return __libc_realloc(ptr, size);
+}
+
+}
+
+#else
+
+static void* countedAlloc(std::size_t size) {
+    allocationCount++;
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new(std::size_t size) {
+    return countedAlloc(size);
+}
+
+void* operator new[](std::size_t size) {
+    return countedAlloc(size);
+}
+
+// The nothrow forms too, or memory the library gets from them would be released by the replaced delete below
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    allocationCount++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    allocationCount++;
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    std::free(ptr);
+}
+
+#endif
+
+std::size_t threadAllocationCount() {
+    return allocationCount;
+}
+
+#else
+
+std::size_t threadAllocationCount() {
+    return 0;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef AMERICANOPTIONSPRICING_ALLOCATIONCOUNTER_H
+#define AMERICANOPTIONSPRICING_ALLOCATIONCOUNTER_H
+
+#include <cstddef>
+
+// Heap allocations are counted in debug builds, or in any build defining PSOR_COUNT_ALLOCATIONS
+#if !defined(NDEBUG) || defined(PSOR_COUNT_ALLOCATIONS)
+#define PSOR_ALLOCATION_COUNTER_ENABLED
+#endif
+
+/**
+ * Number of heap allocations made by the calling thread. With glibc every malloc, calloc and realloc is counted, which
+ * covers operator new and Eigen temporaries; elsewhere, and under sanitizers that replace malloc (address, thread and
+ * memory, with GCC or Clang), only operator new is, so allocations made straight through malloc go unseen.
+ * @return allocation count, always 0 when counting is disabled
+ */
+std::size_t threadAllocationCount();
+
+#endif //AMERICANOPTIONSPRICING_ALLOCATIONCOUNTER_H
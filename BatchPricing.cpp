@@ -0,0 +1,106 @@
+#include "BatchPricing.h"
+#include <memory>
+#include <numeric>
+#include "LockstepPSOR.h"
+#include "SolverProfile.h"
+
+using namespace std;
+
+// Volatility of a contract's grid; under a local volatility the grid depends on the strike instead
+static double gridVol(const ContractBatch& batch, size_t i) {
+    return batch.localVol ? batch.strike[i] : batch.vol[i];
+}
+
+// Contracts sharing expiry, volatility, rate and type share a PDE grid
+static bool sameGrid(const ContractBatch& batch, size_t a, size_t b) {
+    return batch.expiry[a] == batch.expiry[b] && gridVol(batch, a) == gridVol(batch, b)
+        && batch.rate[a] == batch.rate[b] && batch.type[a] == batch.type[b];
+}
+
+// Orders contracts so those sharing a grid are adjacent
+static bool gridBefore(const ContractBatch& batch, size_t a, size_t b) {
+    if(batch.expiry[a] != batch.expiry[b]) return batch.expiry[a] < batch.expiry[b];
+    if(gridVol(batch, a) != gridVol(batch, b)) return gridVol(batch, a) < gridVol(batch, b);
+    if(batch.rate[a] != batch.rate[b]) return batch.rate[a] < batch.rate[b];
+    return batch.type[a] < batch.type[b];
+}
+
+void priceAmericanBatch(const ContractBatch& batch, const BatchResults& results, const PSORSolver solver,
+                        const PricingConfig& config, SolverProfile* profile) {
+    if(batch.count == 0) return;
+    // Group contracts by grid
+    vector<size_t> order(batch.count);
+    iota(order.begin(), order.end(), size_t(0));
+    stable_sort(order.begin(), order.end(), [&batch](size_t a, size_t b){ return gridBefore(batch, a, b); });
+    vector<size_t> groupStart;
+    vector<LockstepGrid> grids;
+    for(size_t k = 0; k < batch.count; k++){
+        size_t i = order[k];
+        if(k == 0 || !sameGrid(batch, order[k - 1], i)){
+            groupStart.push_back(k);
+            grids.push_back(LockstepGrid{batch.expiry[i], batch.localVol ? 0. : batch.vol[i], batch.rate[i],
+                                         batch.type[i], batch.strike[i], batch.localVol});
+        }
+        grids.back().K_max = max(grids.back().K_max, batch.strike[i]);
+        grids.back().moneyness = max(grids.back().moneyness, batch.spot[i] / batch.strike[i]);
+    }
+    groupStart.push_back(batch.count);
+    // PSOR grids are solved several at a time in SIMD lanes, Brennan-Schwartz one at a time
+    size_t width = solver == PSORSolver::PSOR ? size_t(lockstepWidth()) : 1;
+    vector<unique_ptr<PSORWorkspace>> workspaces;
+    vector<PSORWorkspace*> lanes;
+    for(size_t l = 0; l < min(width, grids.size()); l++){
+        workspaces.emplace_back(new PSORWorkspace(config.nodes));
+        lanes.push_back(workspaces.back().get());
+    }
+    for(size_t first = 0; first < grids.size(); first += width){
+        size_t count = min(width, grids.size() - first);
+        if(width > 1){
+            solveNormalizedGridsLockstep(lanes.data(), &grids[first], count, config);
+        }
+        else{
+            const LockstepGrid& grid = grids[first];
+            setupNormalizedGrid(*lanes[0], grid.T, grid.sig, grid.r, grid.type, coveringConfig(config, grid.moneyness));
+            if(grid.localVol) setLocalVolatility(*lanes[0], *grid.localVol, grid.K_max, grid.T, grid.r, config);
+            timeStepNormalizedGrid(*lanes[0], grid.r, grid.type, grid.K_max, solver, nullptr, config);
+        }
+        // Read every contract of each solved group off its grid
+        for(size_t g = first; g < first + count; g++){
+            PSORWorkspace& ws = *lanes[g - first];
+            {
+                PhaseTimer timer(ws.stats, ReadPhase);
+                for(size_t k = groupStart[g]; k < groupStart[g + 1]; k++){
+                    size_t i = order[k];
+                    PricingResult result = readNormalizedGrid(ws, batch.spot[i], batch.strike[i], batch.type[i],
+                                                               config.interpolation);
+                    results.price[i] = result.price;
+                    if(results.delta) results.delta[i] = result.delta;
+                    if(results.gamma) results.gamma[i] = result.gamma;
+                    if(results.theta) results.theta[i] = result.theta;
+                }
+            }
+            if(profile) profile->add(ws.stats, grids[g], config.tolerance);
+        }
+    }
+}
+
+void priceAmericanChainSurface(const double S, const double T, const VolSurface& surface, const vector<double>& strikes,
+                               const double r, const bool type, vector<PricingResult>& results, const VolModel model,
+                               const PSORSolver solver, const PricingConfig& config) {
+    size_t count = strikes.size();
+    results.resize(count);
+    if(count == 0) return;
+    vector<double> spot(count, S), expiry(count, T), vol(count), rate(count, r), price(count), delta(count),
+        gamma(count), theta(count);
+    unique_ptr<bool[]> types(new bool[count]);
+    for(size_t k = 0; k < count; k++){
+        vol[k] = surface.vol(strikes[k], T);
+        types[k] = type;
+    }
+    ContractBatch batch{count, spot.data(), expiry.data(), vol.data(), strikes.data(), rate.data(), types.get(),
+                        model == VolModel::Local ? &surface : nullptr};
+    priceAmericanBatch(batch, BatchResults{price.data(), delta.data(), gamma.data(), theta.data()}, solver, config);
+    for(size_t k = 0; k < count; k++){
+        results[k] = PricingResult{price[k], delta[k], gamma[k], theta[k]};
+    }
+}
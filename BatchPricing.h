@@ -0,0 +1,61 @@
+#ifndef AMERICANOPTIONSPRICING_BATCHPRICING_H
+#define AMERICANOPTIONSPRICING_BATCHPRICING_H
+
+#include <cstddef>
+#include <vector>
+#include "Price_American_PSOR.h"
+#include "VolSurface.h"
+
+class SolverProfile;
+
+/**
+ * Contracts in structure-of-arrays layout, entry i of every array describes contract i. Arrays are owned by the caller.
+ */
+struct ContractBatch {
+    std::size_t count;
+    const double* spot;
+    const double* expiry;
+    const double* vol;
+    const double* strike;
+    const double* rate;
+    const bool* type;       // 1 for a call, 0 for a put
+    const VolSurface* localVol = nullptr;   // when set, vol is ignored and each strike is solved under this surface
+};
+
+/**
+ * Caller owned output buffers with room for every contract of the batch. Greek buffers may be null to skip them.
+ */
+struct BatchResults {
+    double* price;
+    double* delta;
+    double* gamma;
+    double* theta;
+};
+
+/**
+ * Prices a batch of American contracts. Contracts sharing expiry, volatility, rate and type are read off one shared
+ * strike-normalized PDE solve, and with PSOR the distinct grids are solved together in SIMD lanes.
+ * @param profile when given, every grid solve of the batch is added to it
+ */
+void priceAmericanBatch(const ContractBatch& batch, const BatchResults& results,
+                        const PSORSolver solver = PSORSolver::PSOR, const PricingConfig& config = PricingConfig(),
+                        SolverProfile* profile = nullptr);
+
+// How a chain reads its volatility surface
+enum class VolModel {
+    Implied,    // Each contract at the surface volatility of its strike and expiry
+    Local       // The surface as a local volatility in spot, the same for every strike
+};
+
+/**
+ * Prices every strike of a chain under a volatility surface. Strikes no longer share a normalized grid, so each is
+ * solved on its own and, with PSOR, several together in SIMD lanes; the surface is evaluated once per grid node.
+ * @param results output, resized to match strikes
+ */
+void priceAmericanChainSurface(const double S, const double T, const VolSurface& surface,
+                               const std::vector<double>& strikes, const double r, const bool type,
+                               std::vector<PricingResult>& results, const VolModel model = VolModel::Implied,
+                               const PSORSolver solver = PSORSolver::PSOR,
+                               const PricingConfig& config = PricingConfig());
+
+#endif //AMERICANOPTIONSPRICING_BATCHPRICING_H
@@ -0,0 +1,210 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "AllocationCounter.h"
+#include "BatchPricing.h"
+#include "Option.h"
+#include "Price_American_PSOR.h"
+
+using namespace std;
+
+// Timing of one benchmark case
+struct BenchmarkResult {
+    string name;
+    size_t iterations;          // calls of the case body
+    size_t contracts;           // contracts priced per call
+    double nsPerContract;
+    double contractsPerSecond;
+    double allocationsPerCall;  // heap allocations per call of the case body
+};
+
+// Output layout, the machine-readable ones are meant to be diffed between releases
+enum class ReportFormat { Table, CSV, JSON };
+
+// Prices are summed here so the optimizer cannot drop the calls being timed
+static volatile double sink = 0.;
+
+/**
+ * Runs body until minTime seconds have passed, after one untimed warm-up call
+ * @param contracts contracts body prices per call
+ */
+template<class Body>
+static BenchmarkResult measure(const string& name, size_t contracts, double minTime, Body&& body) {
+    using Clock = chrono::steady_clock;
+    body();
+    size_t allocationsBefore = threadAllocationCount();
+    size_t iterations = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0.;
+    do{
+        body();
+        iterations++;
+        elapsed = chrono::duration<double>(Clock::now() - start).count();
+    } while(elapsed < minTime);
+    BenchmarkResult result;
+    result.name = name;
+    result.iterations = iterations;
+    result.contracts = contracts;
+    result.nsPerContract = 1e9 * elapsed / double(iterations * contracts);
+    result.contractsPerSecond = double(iterations * contracts) / elapsed;
+    result.allocationsPerCall = double(threadAllocationCount() - allocationsBefore) / double(iterations);
+    return result;
+}
+
+// Single contract solves, at the money put, across grid sizes and solvers
+static void benchmarkSingle(vector<BenchmarkResult>& results, double minTime) {
+    for(int size: {50, 100, 200, 400}){
+        PricingConfig config;
+        config.nodes = config.timeSteps = size;
+        for(PSORSolver solver: {PSORSolver::PSOR, PSORSolver::BrennanSchwartz}){
+            string name = string("single/") + (solver == PSORSolver::PSOR ? "psor" : "brennan_schwartz") + "/"
+                          + to_string(size);
+            results.push_back(measure(name, 1, minTime, [&](){
+                sink = sink + priceAmericanPSOR(100., 1., .2, 100., .05, false, solver, nullptr, config);
+            }));
+        }
+    }
+}
+
+// Chain construction, every strike is a call and a put
+static void benchmarkChain(vector<BenchmarkResult>& results, double minTime) {
+    Option probe("BENCH", 199., 1., .21, false);
+    size_t contracts = 2 * probe.getChain().strike.size;
+    for(bool computeGreeks: {false, true}){
+        string name = computeGreeks ? "chain/construct_greeks" : "chain/construct";
+        results.push_back(measure(name, contracts, minTime, [&](){
+            Option chain("BENCH", 199., 1., .21, computeGreeks);
+            sink = sink + chain.getChain().call[0];
+        }));
+    }
+    // Spot moves inside the chain reprice off the cached grids
+    Option chain("BENCH", 199., 1., .21, false);
+    double spots[2] = {199.5, 198.5};
+    size_t move = 0;
+    results.push_back(measure("chain/reprice_spot", contracts, minTime, [&](){
+        chain.setStockPrice(spots[move++ % 2]);
+        sink = sink + chain.getChain().put[0];
+    }));
+}
+
+// Strike lookups on a built chain, listed strikes and strikes between them
+static void benchmarkLookup(vector<BenchmarkResult>& results, double minTime) {
+    Option chain("BENCH", 199., 1., .21, false);
+    ChainView view = chain.getChain();
+    vector<double> listed(view.strike.begin(), view.strike.end()), between;
+    for(size_t i = 0; i + 1 < listed.size(); i++) between.push_back(.5 * (listed[i] + listed[i + 1]));
+    results.push_back(measure("lookup/listed", listed.size(), minTime, [&](){
+        double price = 0.;
+        for(double strike: listed){
+            chain.getCallAtStrike(strike, price);
+            sink = sink + price;
+        }
+    }));
+    vector<double> prices(between.size());
+    unique_ptr<StrikeStatus[]> status(new StrikeStatus[between.size()]);
+    results.push_back(measure("lookup/off_chain_bulk", between.size(), minTime, [&](){
+        chain.getCallsAtStrikes(between.data(), between.size(), prices.data(), status.get());
+        sink = sink + prices[0];
+    }));
+}
+
+// Batch throughput over a book of expiries, both types and a spread of strikes
+static void benchmarkBatch(vector<BenchmarkResult>& results, double minTime) {
+    const size_t expiryCount = 8, strikeCount = 32;
+    size_t count = 2 * expiryCount * strikeCount;
+    vector<double> spot(count, 100.), expiry, vol(count, .25), strike, rate(count, .05);
+    unique_ptr<bool[]> type(new bool[count]);
+    for(size_t e = 0; e < expiryCount; e++){
+        for(int t = 0; t < 2; t++){
+            for(size_t k = 0; k < strikeCount; k++){
+                type[expiry.size()] = t == 1;
+                expiry.push_back(.25 * double(e + 1));
+                strike.push_back(70. + 2. * double(k));
+            }
+        }
+    }
+    vector<double> price(count), delta(count), gamma(count), theta(count);
+    ContractBatch batch{count, spot.data(), expiry.data(), vol.data(), strike.data(), rate.data(), type.get()};
+    results.push_back(measure("batch/" + to_string(count), count, minTime, [&](){
+        priceAmericanBatch(batch, BatchResults{price.data(), delta.data(), gamma.data(), theta.data()});
+        sink = sink + price[0];
+    }));
+}
+
+static void report(const vector<BenchmarkResult>& results, ReportFormat format, ostream& out) {
+    switch(format){
+        case ReportFormat::CSV:
+            out << "name,iterations,contracts,ns_per_contract,contracts_per_sec,allocations_per_call\n";
+            for(const auto& r: results){
+                out << r.name << "," << r.iterations << "," << r.contracts << "," << r.nsPerContract << ","
+                    << r.contractsPerSecond << "," << r.allocationsPerCall << "\n";
+            }
+            break;
+        case ReportFormat::JSON:
+            out << "{\"benchmarks\": [\n";
+            for(size_t i = 0; i < results.size(); i++){
+                const BenchmarkResult& r = results[i];
+                out << "  {\"name\": \"" << r.name << "\", \"iterations\": " << r.iterations << ", \"contracts\": "
+                    << r.contracts << ", \"ns_per_contract\": " << r.nsPerContract << ", \"contracts_per_sec\": "
+                    << r.contractsPerSecond << ", \"allocations_per_call\": " << r.allocationsPerCall << "}"
+                    << (i + 1 < results.size() ? ",\n" : "\n");
+            }
+            out << "]}\n";
+            break;
+        case ReportFormat::Table:
+            out << left << setw(32) << "benchmark" << right << setw(14) << "ns/contract" << setw(16) << "contracts/sec"
+                << setw(14) << "allocs/call" << "\n";
+            for(const auto& r: results){
+                out << left << setw(32) << r.name << right << fixed << setprecision(0) << setw(14) << r.nsPerContract
+                    << setw(16) << r.contractsPerSecond << setprecision(1) << setw(14) << r.allocationsPerCall << "\n";
+            }
+            break;
+    }
+}
+
+/**
+ * Benchmarks the pricer. Usage: AmericanOptionsBenchmark [--csv | --json] [--min-time SECONDS] [--filter PREFIX]
+ */
+int main(int argc, char** argv) {
+    ReportFormat format = ReportFormat::Table;
+    double minTime = .2;
+    string filter;
+    for(int i = 1; i < argc; i++){
+        if(strcmp(argv[i], "--csv") == 0) format = ReportFormat::CSV;
+        else if(strcmp(argv[i], "--json") == 0) format = ReportFormat::JSON;
+        else if(strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) minTime = atof(argv[++i]);
+        else if(strcmp(argv[i], "--filter") == 0 && i + 1 < argc) filter = argv[++i];
+        else{
+            cerr << "Usage: " << argv[0] << " [--csv | --json] [--min-time SECONDS] [--filter PREFIX]\n";
+            return 1;
+        }
+    }
+    vector<BenchmarkResult> results;
+    struct Group {
+        const char* prefix;
+        void (*run)(vector<BenchmarkResult>&, double);
+    };
+    const Group groups[] = {{"single", benchmarkSingle}, {"chain", benchmarkChain}, {"lookup", benchmarkLookup},
+                            {"batch", benchmarkBatch}};
+    for(const Group& group: groups){
+        // A filter selects the groups it is a prefix of, or that are a prefix of it
+        string prefix = group.prefix;
+        size_t common = min(prefix.size(), filter.size());
+        if(prefix.compare(0, common, filter, 0, common) == 0) group.run(results, minTime);
+    }
+    // Cases within a group are kept only when they match the whole filter
+    vector<BenchmarkResult> selected;
+    for(const auto& r: results){
+        if(r.name.compare(0, filter.size(), filter) == 0) selected.push_back(r);
+    }
+#ifndef PSOR_ALLOCATION_COUNTER_ENABLED
+    cerr << "Allocation counting is disabled, allocations read 0\n";
+#endif
+    report(selected, format, cout);
+    return 0;
+}
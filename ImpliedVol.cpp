@@ -0,0 +1,114 @@
+#include "ImpliedVol.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include "Tracing.h"
+
+using namespace std;
+
+/**
+ * Price of the contract at sig, solved into ws, and its vega read off the same grid through the gamma
+ */
+static double priceWithVega(PSORWorkspace& ws, const double S, const double T, const double sig, const double K,
+                            const double r, const bool type, const PSORSolver solver, const PricingConfig& config,
+                            double& vega) {
+    solveNormalizedGrid(ws, T, sig, r, type, K, solver, nullptr, coveringConfig(config, S / K), S / K);
+    PricingResult result = readNormalizedGrid(ws, S, K, type, config.interpolation);
+    vega = sig * S * S * T * result.gamma;
+    return result.price;
+}
+
+/**
+ * Bracketed Newton search of impliedVolAmerican in a caller owned workspace
+ */
+static ImpliedVolResult impliedVol(PSORWorkspace& ws, const double price, const double S, const double T,
+                                   const double K, const double r, const bool type, const double guess,
+                                   const PSORSolver solver, const PricingConfig& config) {
+    TraceSpan span("impliedVol", "solve", type ? "call" : "put");
+    ImpliedVolResult result{NAN, 0, ImpliedVolStatus::NotConverged};
+    // An American contract is worth at least its exercise value
+    if(price <= max(type ? S - K : K - S, 0.)){
+        result.status = ImpliedVolStatus::BelowBound;
+        return result;
+    }
+    double tolerance = impliedVolPriceTolerance * K;
+    // Bracket ends only count once priced, until then the search steps out geometrically rather than bisecting
+    double lo = impliedVolMin, hi = impliedVolMax;
+    bool loPriced = false, hiPriced = false;
+    double sig = min(max(guess, lo), hi);
+    while(result.solves < impliedVolMaxSolves){
+        double vega;
+        double diff = priceWithVega(ws, S, T, sig, K, r, type, solver, config, vega) - price;
+        result.solves++;
+        result.vol = sig;
+        if(abs(diff) < tolerance){
+            result.status = ImpliedVolStatus::Converged;
+            return result;
+        }
+        // Prices rise with volatility
+        if(diff < 0.){
+            if(sig == impliedVolMax){
+                result.vol = NAN;
+                result.status = ImpliedVolStatus::AboveBound;
+                return result;
+            }
+            lo = sig;
+            loPriced = true;
+        }
+        else{
+            if(sig == impliedVolMin){
+                result.vol = NAN;
+                result.status = ImpliedVolStatus::BelowBound;
+                return result;
+            }
+            hi = sig;
+            hiPriced = true;
+        }
+        if(hi - lo < impliedVolTolerance){
+            result.vol = .5 * (lo + hi);
+            result.status = ImpliedVolStatus::Converged;
+            return result;
+        }
+        double next = vega > 0. ? sig - diff / vega : NAN;
+        if(!(next > lo && next < hi)){
+            if(diff < 0. && !hiPriced) next = min(2. * sig, hi);
+            else if(diff > 0. && !loPriced) next = max(.5 * sig, lo);
+            else next = .5 * (lo + hi);
+        }
+        sig = next;
+    }
+    return result;
+}
+
+ImpliedVolResult impliedVolAmerican(const double price, const double S, const double T, const double K, const double r,
+                                    const bool type, const double guess, const PSORSolver solver,
+                                    const PricingConfig& config) {
+    PSORWorkspace ws(config.nodes);
+    return impliedVol(ws, price, S, T, K, r, type, guess, solver, config);
+}
+
+void impliedVolChainAmerican(const vector<double>& prices, const double S, const double T, const vector<double>& strikes,
+                             const double r, const bool type, vector<ImpliedVolResult>& results, const double guess,
+                             const PSORSolver solver, const PricingConfig& config) {
+    size_t count = strikes.size();
+    results.resize(count);
+    if(count == 0) return;
+    // Strikes in increasing order, and the one nearest the money
+    vector<size_t> order(count);
+    iota(order.begin(), order.end(), size_t(0));
+    sort(order.begin(), order.end(), [&strikes](size_t a, size_t b){ return strikes[a] < strikes[b]; });
+    size_t atm = 0;
+    for(size_t k = 1; k < count; k++){
+        if(abs(strikes[order[k]] - S) < abs(strikes[order[atm]] - S)) atm = k;
+    }
+    PSORWorkspace ws(config.nodes);
+    // Each strike starts from the neighbour on its side of the money, or guess when that one failed
+    auto solve = [&](size_t k, size_t neighbour){
+        const ImpliedVolResult& from = results[order[neighbour]];
+        double start = from.status == ImpliedVolStatus::Converged ? from.vol : guess;
+        results[order[k]] = impliedVol(ws, prices[order[k]], S, T, strikes[order[k]], r, type, start, solver, config);
+    };
+    results[order[atm]] = impliedVol(ws, prices[order[atm]], S, T, strikes[order[atm]], r, type, guess, solver, config);
+    for(size_t k = atm + 1; k < count; k++) solve(k, k - 1);
+    for(size_t k = atm; k-- > 0;) solve(k, k + 1);
+}
@@ -0,0 +1,54 @@
+#ifndef AMERICANOPTIONSPRICING_IMPLIEDVOL_H
+#define AMERICANOPTIONSPRICING_IMPLIEDVOL_H
+
+#include <vector>
+#include "Price_American_PSOR.h"
+
+// Implied volatility search settings
+const double impliedVolMin = 1e-3;          // bracket the volatility is searched in
+const double impliedVolMax = 5.;
+const double impliedVolPriceTolerance = 1e-6;   // on the price, in units of strike
+const double impliedVolTolerance = 1e-7;    // on the bracket width
+const int impliedVolMaxSolves = 30;
+
+// Outcome of an implied volatility search
+enum class ImpliedVolStatus {
+    Converged,
+    BelowBound,     // price below what the lowest volatility gives, intrinsic value or less
+    AboveBound,     // price above what the highest volatility gives
+    NotConverged    // solve budget spent, vol is the best estimate
+};
+
+// Implied volatility of one contract, with the cost of finding it
+struct ImpliedVolResult {
+    double vol;         // NaN when the price is out of bounds
+    int solves;         // PDE solves spent
+    ImpliedVolStatus status;
+};
+
+/**
+ * Volatility at which the American PDE price of a contract matches price. Bracketed Newton: every step solves the PDE
+ * once and takes its slope from the grid's gamma through vega = sig S^2 T gamma, exact for European contracts and close
+ * for American ones; steps leaving the bracket, which each solve narrows, fall back to bisection.
+ * The default solver is direct, so the price is a smooth function of volatility with no iteration noise to chase.
+ * @param guess starting volatility, e.g. the implied volatility of a neighbouring strike
+ */
+ImpliedVolResult impliedVolAmerican(const double price, const double S, const double T, const double K, const double r,
+                                    const bool type, const double guess = .2,
+                                    const PSORSolver solver = PSORSolver::BrennanSchwartz,
+                                    const PricingConfig& config = PricingConfig());
+
+/**
+ * Implied volatilities of a chain, strike by strike outward from the money. Each strike starts from the implied
+ * volatility of its already solved neighbour, which on a smooth smile is a few Newton steps away.
+ * @param prices prices[k] is the market price at strikes[k]
+ * @param guess starting volatility of the strike nearest the money
+ * @param results output, resized to match strikes
+ */
+void impliedVolChainAmerican(const std::vector<double>& prices, const double S, const double T,
+                             const std::vector<double>& strikes, const double r, const bool type,
+                             std::vector<ImpliedVolResult>& results, const double guess = .2,
+                             const PSORSolver solver = PSORSolver::BrennanSchwartz,
+                             const PricingConfig& config = PricingConfig());
+
+#endif //AMERICANOPTIONSPRICING_IMPLIEDVOL_H
@@ -0,0 +1,404 @@
+#include "LockstepPSOR.h"
+#include "Tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PSOR_LOCKSTEP_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace Eigen;
+
+/**
+ * Grids interleaved node by node, element i * width + l holds node i of lane l
+ */
+struct PackedGrids {
+    PackedGrids(const PricingConfig& config, int width)
+        : N(config.nodes), width(width), config(config), lower((N + 1) * width), invDiag((N + 1) * width),
+          upper((N + 1) * width), rhsLower((N + 1) * width), rhsDiag((N + 1) * width), rhsUpper((N + 1) * width),
+          obstacle((N + 1) * width), w((N + 1) * width), wOld((N + 1) * width), v((N + 1) * width),
+          vPrev((N + 1) * width), d((N + 1) * width),
+          err(width), r(width), dt(width), weight(width), weightStep(width), lockBelow(width),
+          lockAbove(width), active(width), check(width), error(width), heldFrom(width), residual(width), iterations(width),
+          lastIterations(width), grid(width), workspace(width), boundary(width), stats(width){
+    }
+
+    int N;
+    int width;
+    const PricingConfig& config;
+    vector<double> lower, invDiag, upper;       // M1, with the reciprocal of its diagonal
+    vector<double> rhsLower, rhsDiag, rhsUpper; // M2
+    vector<double> obstacle, w, wOld, v, vPrev, d;
+    // Per lane
+    vector<double> err, r, dt, weight, weightStep;
+    vector<double> lockBelow, lockAbove;    // nodes outside [lockBelow, lockAbove] are held on the payoff
+    vector<double> active, check;           // 1 while iterating, 1 while relaxing only the held nodes
+    vector<double> error, heldFrom;         // squared change of the last sweep, and of the sweep before the check
+    vector<double> residual;                // final squared change, as computeSOR
+    vector<int> iterations, lastIterations;
+    vector<const LockstepGrid*> grid;
+    vector<PSORWorkspace*> workspace;
+    vector<ExerciseBoundary> boundary;
+    vector<SolverStats> stats;
+};
+
+static void packOperators(PackedGrids& p, int l, const PSORWorkspace& ws) {
+    for(int i = 0; i <= p.N; i++){
+        int k = i * p.width + l;
+        p.lower[k] = ws.M1.lower(i);
+        p.invDiag[k] = ws.invDiag(i);
+        p.upper[k] = ws.M1.upper(i);
+        p.rhsLower[k] = ws.M2.lower(i);
+        p.rhsDiag[k] = ws.M2.diag(i);
+        p.rhsUpper[k] = ws.M2.upper(i);
+    }
+}
+
+/**
+ * Interleaves the set up grids into p, repeating the last grid in unused lanes
+ */
+static void packGrids(PackedGrids& p, PSORWorkspace* const* lanes, const LockstepGrid* grids, size_t count) {
+    for(int l = 0; l < p.width; l++){
+        size_t g = min(size_t(l), count - 1);
+        PSORWorkspace& ws = *lanes[g];
+        packOperators(p, l, ws);
+        for(int i = 0; i <= p.N; i++){
+            int k = i * p.width + l;
+            p.obstacle[k] = ws.obstacle(i);
+            p.w[k] = ws.w(i);
+            p.wOld[k] = ws.wOld(i);
+            p.v[k] = ws.v(i);
+        }
+        p.err[l] = p.config.tolerance / (grids[g].K_max * grids[g].K_max);
+        p.r[l] = grids[g].r;
+        p.dt[l] = ws.dt;
+        p.weight[l] = p.config.weight > 0. ? p.config.weight : estimateSORWeight(ws.M1, p.N);
+        p.weightStep[l] = sorWeightStep;
+        p.lastIterations[l] = 0;
+        p.grid[l] = &grids[g];
+        p.workspace[l] = &ws;
+        p.boundary[l] = ExerciseBoundary();
+        // Started by setupNormalizedGrid, with its setup time
+        p.stats[l] = ws.stats;
+        p.stats[l].stepIterations.reserve(p.config.timeSteps);
+    }
+}
+
+static void unpackGrids(const PackedGrids& p, PSORWorkspace* const* lanes, size_t count) {
+    for(size_t l = 0; l < count; l++){
+        PSORWorkspace& ws = *lanes[l];
+        for(int i = 0; i <= p.N; i++){
+            ws.v(i) = p.v[i * p.width + l];
+            ws.vPrev(i) = p.vPrev[i * p.width + l];
+        }
+        ws.stats = p.stats[l];
+    }
+}
+
+/**
+ * Switches every lane from the smoothing steps to the configured scheme, as solveNormalizedGrid
+ */
+static void endSmoothing(PackedGrids& p, int M, int t) {
+    if(p.config.smoothingSteps == 0 || t != M - 1 - p.config.smoothingSteps) return;
+    for(int l = 0; l < p.width; l++){
+        setOperatorTheta(*p.workspace[l], p.config.theta);
+        packOperators(p, l, *p.workspace[l]);
+    }
+}
+
+/**
+ * Warm starts every lane and holds its exercised nodes, as solveNormalizedGrid
+ */
+static void startStep(PackedGrids& p) {
+    InnerStride<> stride(p.width);
+    for(int l = 0; l < p.width; l++){
+        Map<VectorXd, 0, InnerStride<>> v(p.v.data() + l, p.N + 1, stride);
+        Map<const VectorXd, 0, InnerStride<>> w(p.w.data() + l, p.N + 1, stride);
+        Map<const VectorXd, 0, InnerStride<>> wOld(p.wOld.data() + l, p.N + 1, stride);
+        bool type = p.grid[l]->type;
+        int held = warmStart(v, w, wOld, p.workspace[l]->obstacle, p.N, type, p.boundary[l]);
+        p.lockBelow[l] = type ? 0 : held;
+        p.lockAbove[l] = type ? p.N - held : p.N;
+        p.active[l] = 1.;
+        p.check[l] = 0.;
+        p.iterations[l] = 0;
+    }
+}
+
+/**
+ * Moves each lane on after a sweep, following the convergence logic of computeSOR
+ * @return whether any lane is still iterating
+ */
+static bool finishSweep(PackedGrids& p) {
+    bool iterating = false;
+    for(int l = 0; l < p.width; l++){
+        if(p.active[l] == 0.) continue;
+        bool held = p.lockBelow[l] > 0. || p.lockAbove[l] < p.N;
+        if(p.check[l] != 0.){
+            // The sweep relaxed the held nodes only
+            p.check[l] = 0.;
+            p.residual[l] = p.heldFrom[l] + p.error[l];
+            if(p.residual[l] < p.err[l]){
+                p.active[l] = 0.;
+                continue;
+            }
+            p.lockBelow[l] = 0.;
+            p.lockAbove[l] = p.N;
+        }
+        else{
+            p.iterations[l]++;
+            p.residual[l] = p.error[l];
+            if(p.error[l] < p.err[l]){
+                if(!held){
+                    p.active[l] = 0.;
+                    continue;
+                }
+                p.check[l] = 1.;
+                p.heldFrom[l] = p.error[l];
+                iterating = true;
+                continue;
+            }
+        }
+        if(p.iterations[l] == p.config.maxIter) p.active[l] = 0.;
+        else iterating = true;
+    }
+    return iterating;
+}
+
+/**
+ * Records the time step's sweep counts, tunes each lane's relaxation factor and shifts the slices, as
+ * solveNormalizedGrid
+ */
+static void finishStep(PackedGrids& p) {
+    for(int l = 0; l < p.width; l++){
+        double K_max = p.grid[l]->K_max;
+        recordIterations(p.stats[l], p.iterations[l], p.weight[l], p.residual[l] * K_max * K_max,
+                         p.residual[l] < p.err[l]);
+        if(p.config.weight <= 0.) adaptSORWeight(p.weight[l], p.weightStep[l], p.iterations[l], p.lastIterations[l]);
+    }
+    copy(p.w.begin(), p.w.end(), p.wOld.begin());
+    copy(p.v.begin(), p.v.end(), p.w.begin());
+}
+
+/**
+ * Right hand side of time step t for every lane, as initPrev
+ */
+static void packedBoundary(PackedGrids& p, int M, int t) {
+    for(int l = 0; l < p.width; l++){
+        gridBoundary(p.grid[l]->type, p.workspace[l]->S_i(p.N), exp(-p.r[l] * (M - t) * p.dt[l]), p.d[l],
+                     p.d[p.N * p.width + l]);
+    }
+}
+
+#ifdef PSOR_LOCKSTEP_X86
+
+// AVX-512 implies FMA, keep GCC from fusing the multiplies and adds the scalar solver rounds separately
+#define PSOR_TARGET_AVX2 __attribute__((target("avx2")))
+#ifdef __clang__
+#define PSOR_TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+#define PSOR_TARGET_AVX512 __attribute__((target("avx512f"), optimize("fp-contract=off")))
+#endif
+
+/**
+ * Time steps 4 packed grids with AVX2. Arithmetic follows initPrev and computeSOR operation for operation.
+ */
+PSOR_TARGET_AVX2 static void solvePackedAVX2(PackedGrids& p, int M) {
+    const int W = 4;
+    const int N = p.N;
+    const __m256d zero = _mm256_setzero_pd();
+    double* lower = p.lower.data();
+    double* invDiag = p.invDiag.data();
+    double* upper = p.upper.data();
+    const double* rhsLower = p.rhsLower.data();
+    const double* rhsDiag = p.rhsDiag.data();
+    const double* rhsUpper = p.rhsUpper.data();
+    double* obstacle = p.obstacle.data();
+    double* w = p.w.data();
+    double* v = p.v.data();
+    double* d = p.d.data();
+    for(int t = M - 1; t >= 0; t--){
+        endSmoothing(p, M, t);
+        if(t == 0) copy(p.v.begin(), p.v.end(), p.vPrev.begin());
+        // Compute previous time step
+        packedBoundary(p, M, t);
+        for(int i = 1; i < N; i++){
+            int k = i * W;
+            __m256d di = _mm256_mul_pd(_mm256_loadu_pd(rhsLower + k), _mm256_loadu_pd(w + k - W));
+            di = _mm256_add_pd(di, _mm256_mul_pd(_mm256_loadu_pd(rhsDiag + k), _mm256_loadu_pd(w + k)));
+            di = _mm256_add_pd(di, _mm256_mul_pd(_mm256_loadu_pd(rhsUpper + k), _mm256_loadu_pd(w + k + W)));
+            _mm256_storeu_pd(d + k, di);
+        }
+        // Projected SOR, lanes drop out as they converge
+        startStep(p);
+        const __m256d weight = _mm256_loadu_pd(p.weight.data());
+        do{
+            const __m256d active = _mm256_cmp_pd(_mm256_loadu_pd(p.active.data()), zero, _CMP_NEQ_OQ);
+            const __m256d check = _mm256_cmp_pd(_mm256_loadu_pd(p.check.data()), zero, _CMP_NEQ_OQ);
+            const __m256d lockBelow = _mm256_loadu_pd(p.lockBelow.data());
+            const __m256d lockAbove = _mm256_loadu_pd(p.lockAbove.data());
+            __m256d error = _mm256_setzero_pd();
+            for(int i = 0; i <= N; i++){
+                int k = i * W;
+                __m256d vi = _mm256_loadu_pd(v + k);
+                __m256d y;
+                if(i == 0){
+                    y = _mm256_sub_pd(_mm256_loadu_pd(d), _mm256_mul_pd(_mm256_loadu_pd(upper), vi));
+                }
+                else if(i == N){
+                    y = _mm256_sub_pd(_mm256_loadu_pd(d + k), _mm256_mul_pd(_mm256_loadu_pd(lower + k), _mm256_loadu_pd(v + k - W)));
+                }
+                else{
+                    y = _mm256_sub_pd(_mm256_loadu_pd(d + k), _mm256_mul_pd(_mm256_loadu_pd(lower + k), _mm256_loadu_pd(v + k - W)));
+                    y = _mm256_sub_pd(y, _mm256_mul_pd(_mm256_loadu_pd(upper + k), _mm256_loadu_pd(v + k + W)));
+                }
+                y = _mm256_mul_pd(y, _mm256_loadu_pd(invDiag + k));
+                y = _mm256_add_pd(vi, _mm256_mul_pd(weight, _mm256_sub_pd(y, vi)));
+                // max(obstacle, y) returns y on ties, as std::max(y, obstacle)
+                y = _mm256_max_pd(_mm256_loadu_pd(obstacle + k), y);
+                // Held nodes keep their value, and are the only ones relaxed while checking
+                __m256d node = _mm256_set1_pd(double(i));
+                __m256d held = _mm256_or_pd(_mm256_cmp_pd(node, lockBelow, _CMP_LT_OQ),
+                                            _mm256_cmp_pd(node, lockAbove, _CMP_GT_OQ));
+                y = _mm256_blendv_pd(y, vi, _mm256_xor_pd(held, check));
+                __m256d change = _mm256_sub_pd(y, vi);
+                error = _mm256_add_pd(error, _mm256_mul_pd(change, change));
+                _mm256_storeu_pd(v + k, _mm256_blendv_pd(vi, y, active));
+            }
+            _mm256_storeu_pd(p.error.data(), error);
+        } while(finishSweep(p));
+        finishStep(p);
+    }
+}
+
+/**
+ * Time steps 8 packed grids with AVX-512, see solvePackedAVX2
+ */
+PSOR_TARGET_AVX512 static void solvePackedAVX512(PackedGrids& p, int M) {
+    const int W = 8;
+    const int N = p.N;
+    const __m512d zero = _mm512_setzero_pd();
+    double* lower = p.lower.data();
+    double* invDiag = p.invDiag.data();
+    double* upper = p.upper.data();
+    const double* rhsLower = p.rhsLower.data();
+    const double* rhsDiag = p.rhsDiag.data();
+    const double* rhsUpper = p.rhsUpper.data();
+    double* obstacle = p.obstacle.data();
+    double* w = p.w.data();
+    double* v = p.v.data();
+    double* d = p.d.data();
+    for(int t = M - 1; t >= 0; t--){
+        endSmoothing(p, M, t);
+        if(t == 0) copy(p.v.begin(), p.v.end(), p.vPrev.begin());
+        // Compute previous time step
+        packedBoundary(p, M, t);
+        for(int i = 1; i < N; i++){
+            int k = i * W;
+            __m512d di = _mm512_mul_pd(_mm512_loadu_pd(rhsLower + k), _mm512_loadu_pd(w + k - W));
+            di = _mm512_add_pd(di, _mm512_mul_pd(_mm512_loadu_pd(rhsDiag + k), _mm512_loadu_pd(w + k)));
+            di = _mm512_add_pd(di, _mm512_mul_pd(_mm512_loadu_pd(rhsUpper + k), _mm512_loadu_pd(w + k + W)));
+            _mm512_storeu_pd(d + k, di);
+        }
+        // Projected SOR, lanes drop out as they converge
+        startStep(p);
+        const __m512d weight = _mm512_loadu_pd(p.weight.data());
+        do{
+            const __mmask8 active = _mm512_cmp_pd_mask(_mm512_loadu_pd(p.active.data()), zero, _CMP_NEQ_OQ);
+            const __mmask8 check = _mm512_cmp_pd_mask(_mm512_loadu_pd(p.check.data()), zero, _CMP_NEQ_OQ);
+            const __m512d lockBelow = _mm512_loadu_pd(p.lockBelow.data());
+            const __m512d lockAbove = _mm512_loadu_pd(p.lockAbove.data());
+            __m512d error = _mm512_setzero_pd();
+            for(int i = 0; i <= N; i++){
+                int k = i * W;
+                __m512d vi = _mm512_loadu_pd(v + k);
+                __m512d y;
+                if(i == 0){
+                    y = _mm512_sub_pd(_mm512_loadu_pd(d), _mm512_mul_pd(_mm512_loadu_pd(upper), vi));
+                }
+                else if(i == N){
+                    y = _mm512_sub_pd(_mm512_loadu_pd(d + k), _mm512_mul_pd(_mm512_loadu_pd(lower + k), _mm512_loadu_pd(v + k - W)));
+                }
+                else{
+                    y = _mm512_sub_pd(_mm512_loadu_pd(d + k), _mm512_mul_pd(_mm512_loadu_pd(lower + k), _mm512_loadu_pd(v + k - W)));
+                    y = _mm512_sub_pd(y, _mm512_mul_pd(_mm512_loadu_pd(upper + k), _mm512_loadu_pd(v + k + W)));
+                }
+                y = _mm512_mul_pd(y, _mm512_loadu_pd(invDiag + k));
+                y = _mm512_add_pd(vi, _mm512_mul_pd(weight, _mm512_sub_pd(y, vi)));
+                // max(obstacle, y) returns y on ties, as std::max(y, obstacle); the full mask form keeps GCC from
+                // warning about the unmasked intrinsic's undefined pass-through register
+                y = _mm512_mask_max_pd(y, 0xFF, _mm512_loadu_pd(obstacle + k), y);
+                // Held nodes keep their value, and are the only ones relaxed while checking
+                __m512d node = _mm512_set1_pd(double(i));
+                __mmask8 held = _mm512_cmp_pd_mask(node, lockBelow, _CMP_LT_OQ) | _mm512_cmp_pd_mask(node, lockAbove, _CMP_GT_OQ);
+                y = _mm512_mask_blend_pd(__mmask8(held ^ check), y, vi);
+                __m512d change = _mm512_sub_pd(y, vi);
+                error = _mm512_add_pd(error, _mm512_mul_pd(change, change));
+                _mm512_storeu_pd(v + k, _mm512_mask_blend_pd(active, vi, y));
+            }
+            _mm512_storeu_pd(p.error.data(), error);
+        } while(finishSweep(p));
+        finishStep(p);
+    }
+}
+
+#endif
+
+// Widest kernel allowed, 0 for no cap, see setLockstepWidthLimit
+static atomic<int> widthLimit(0);
+
+int lockstepWidth() {
+#ifdef PSOR_LOCKSTEP_X86
+    int limit = widthLimit.load(memory_order_relaxed);
+    if(limit == 0) limit = 8;
+    if(limit >= 8 && __builtin_cpu_supports("avx512f")) return 8;
+    if(limit >= 4 && __builtin_cpu_supports("avx2")) return 4;
+#endif
+    return 1;
+}
+
+void setLockstepWidthLimit(int width) {
+    widthLimit.store(width, memory_order_relaxed);
+}
+
+void solveNormalizedGridsLockstep(PSORWorkspace* const* lanes, const LockstepGrid* grids, size_t count,
+                                  const PricingConfig& config) {
+    for(size_t g = 0; g < count; g++){
+        setupNormalizedGrid(*lanes[g], grids[g].T, grids[g].sig, grids[g].r, grids[g].type,
+                            coveringConfig(config, grids[g].moneyness));
+        if(grids[g].localVol){
+            setLocalVolatility(*lanes[g], *grids[g].localVol, grids[g].K_max, grids[g].T, grids[g].r, config);
+        }
+    }
+    int width = lockstepWidth();
+    if(width == 1){
+        // Scalar fallback
+        for(size_t g = 0; g < count; g++){
+            timeStepNormalizedGrid(*lanes[g], grids[g].r, grids[g].type, grids[g].K_max, PSORSolver::PSOR, nullptr,
+                                   config);
+        }
+        return;
+    }
+#ifdef PSOR_LOCKSTEP_X86
+    PackedGrids packed(config, width);
+    for(size_t first = 0; first < count; first += width){
+        size_t lanesUsed = min(count - first, size_t(width));
+        packGrids(packed, lanes + first, grids + first, lanesUsed);
+        SolverStats group;
+        {
+            TraceSpan span("solvePackedGrids", "solve", width == 8 ? "avx512" : "avx2");
+            PhaseTimer timer(group, SolvePhase);
+            if(width == 8) solvePackedAVX512(packed, config.timeSteps);
+            else solvePackedAVX2(packed, config.timeSteps);
+        }
+        unpackGrids(packed, lanes + first, lanesUsed);
+        // Lanes step together, each is charged an equal share of the time stepping, right hand sides included
+        for(size_t l = 0; l < lanesUsed; l++){
+            lanes[first + l]->stats.phaseSeconds[SolvePhase] += group.phaseSeconds[SolvePhase] / double(lanesUsed);
+        }
+    }
+#endif
+}
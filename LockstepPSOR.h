@@ -0,0 +1,43 @@
+#ifndef AMERICANOPTIONSPRICING_LOCKSTEPPSOR_H
+#define AMERICANOPTIONSPRICING_LOCKSTEPPSOR_H
+
+#include <cstddef>
+#include "Price_American_PSOR.h"
+
+// One strike-normalized grid to solve, see solveNormalizedGrid
+struct LockstepGrid {
+    double T;
+    double sig;
+    double r;
+    bool type;
+    double K_max;
+    const VolSurface* localVol = nullptr;   // local volatility read at K_max instead of sig, see setLocalVolatility
+    double moneyness = 0.;  // largest S / K read off the grid, widens it, see coveringConfig
+};
+
+/**
+ * Number of grids the fastest kernel supported by this CPU advances together: 8 with AVX-512, 4 with AVX2, otherwise 1.
+ * Capped by setLockstepWidthLimit.
+ */
+int lockstepWidth();
+
+/**
+ * Caps the kernel solveNormalizedGridsLockstep dispatches to, so each kernel the CPU supports can be checked against the
+ * scalar solver on the same machine. Set between solves only.
+ * @param width widest kernel allowed, 1 for the scalar fallback, 4 for AVX2, 8 or 0 for no cap
+ */
+void setLockstepWidthLimit(int width);
+
+/**
+ * Solves count strike-normalized grids with PSOR, one grid per SIMD lane. Gauss-Seidel is sequential along the grid but
+ * independent grids are not, so each sweep advances every lane through the same node at once, with the projection done
+ * as a vector max. Each lane keeps its own relaxation factor and stops iterating when it converges, so results and
+ * iteration counts match solveNormalizedGrid. Falls back to solving the grids one by one when the CPU has neither AVX2
+ * nor AVX-512.
+ * @param lanes count workspaces of config.nodes nodes, each receives the solution of the matching grid
+ * @param config shared by every grid
+ */
+void solveNormalizedGridsLockstep(PSORWorkspace* const* lanes, const LockstepGrid* grids, std::size_t count,
+                                  const PricingConfig& config = PricingConfig());
+
+#endif //AMERICANOPTIONSPRICING_LOCKSTEPPSOR_H
@@ -0,0 +1,160 @@
+#include "MarketDataPipeline.h"
+#include <cctype>
+#include <cstdlib>
+
+using namespace std;
+
+MarketDataPipeline::MarketDataPipeline(vector<Stock>& stocks, unsigned int consumers)
+    : stocks(stocks), quotes(new Quote[stocks.size()]), queue(max(size_t(1), stocks.size())), closing(false),
+      sleepers(0), ticks(0), updates(0), rejected(0){
+    for(size_t i = 0; i < stocks.size(); i++){
+        index[stocks[i].getSymbol()] = i;
+        quotes[i].version = 0;
+        quotes[i].price = stocks[i].getPrice();
+        quotes[i].volatility = stocks[i].getVolatility();
+        quotes[i].state = Idle;
+    }
+    if(consumers == 0) consumers = 1;
+    for(unsigned int i = 0; i < consumers; i++) this->consumers.emplace_back(&MarketDataPipeline::consumerLoop, this);
+}
+
+MarketDataPipeline::~MarketDataPipeline() {
+    close();
+    // The consumers have stopped, so nothing is notifying the stocks
+    for(const auto& subscription: subscriptions) stocks[subscription.first].unsubscribe(subscription.second);
+}
+
+bool MarketDataPipeline::subscribe(Option& chain) {
+    auto found = index.find(chain.getSymbol());
+    if(found == index.end()) return false;
+    size_t handle = stocks[found->second].subscribe([&chain](const Stock& stock){
+        chain.setQuote(stock.getPrice(), stock.getVolatility());
+    });
+    subscriptions.emplace_back(found->second, handle);
+    return true;
+}
+
+bool MarketDataPipeline::publish(const string& symbol, double price, double volatility) {
+    auto found = index.find(symbol);
+    if(found == index.end()){
+        rejected++;
+        return false;
+    }
+    publish(found->second, price, volatility);
+    return true;
+}
+
+size_t MarketDataPipeline::ingest(istream& in) {
+    size_t published = 0;
+    string line, symbol;
+    while(getline(in, line)){
+        const char* p = line.c_str();
+        while(isspace((unsigned char)*p)) p++;
+        if(*p == '\0' || *p == '#') continue;
+        const char* end = p;
+        while(*end != '\0' && !isspace((unsigned char)*end)) end++;
+        symbol.assign(p, end);
+        char* next;
+        double price = strtod(end, &next);
+        if(next == end || price <= 0.){
+            rejected++;
+            continue;
+        }
+        // Volatility is optional, strtod leaves it at 0 when absent
+        double volatility = strtod(next, nullptr);
+        if(publish(symbol, price, volatility)) published++;
+    }
+    return published;
+}
+
+void MarketDataPipeline::publish(size_t stock, double price, double volatility) {
+    Quote& quote = quotes[stock];
+    // Only the producer writes, so the last volatility can be read back without the lock
+    if(volatility <= 0.) volatility = quote.volatility.load(memory_order_relaxed);
+    unsigned int version = quote.version.load(memory_order_relaxed);
+    quote.version.store(version + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    quote.price.store(price, memory_order_relaxed);
+    quote.volatility.store(volatility, memory_order_relaxed);
+    quote.version.store(version + 2);
+    ticks++;
+    // Queue the stock unless an update for it is pending, which will now read this quote
+    int state = quote.state.load();
+    while(true){
+        if(state == Idle && quote.state.compare_exchange_weak(state, Queued)){
+            // A stock is queued at most once, so the ring always has room, though a consumer may still be copying
+            // out of the slot it claimed a lap ago
+            queue.pushWait(stock);
+            break;
+        }
+        if(state == Running && quote.state.compare_exchange_weak(state, Dirty)) break;
+        if(state == Queued || state == Dirty) break;
+    }
+    // Consumers announce themselves before their last look at the queue, so one of the two sees the other
+    atomic_thread_fence(memory_order_seq_cst);
+    if(sleepers.load() > 0){
+        {
+            lock_guard<mutex> lock(sleepMutex);
+        }
+        wake.notify_one();
+    }
+}
+
+void MarketDataPipeline::close() {
+    if(closing.exchange(true)) return;
+    {
+        lock_guard<mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+    for(auto& consumer: consumers) consumer.join();
+}
+
+IngestStats MarketDataPipeline::stats() const {
+    IngestStats result;
+    result.ticks = ticks.load();
+    result.updates = updates.load();
+    result.rejected = rejected.load();
+    return result;
+}
+
+void MarketDataPipeline::consumerLoop() {
+    size_t stock;
+    while(true){
+        if(queue.pop(stock)){
+            apply(stock);
+            continue;
+        }
+        // The producer queues everything before closing, so an empty queue after close is final
+        if(closing.load()) return;
+        unique_lock<mutex> lock(sleepMutex);
+        sleepers++;
+        atomic_thread_fence(memory_order_seq_cst);
+        wake.wait(lock, [this]{ return !queue.empty() || closing.load(); });
+        sleepers--;
+    }
+}
+
+/**
+ * Applies the latest quote of a queued stock, again while ticks for it keep landing during the update
+ */
+void MarketDataPipeline::apply(size_t stock) {
+    Quote& quote = quotes[stock];
+    quote.state.store(Running);
+    while(true){
+        // Sequence lock read, retried while the producer is writing
+        double price, volatility;
+        unsigned int version;
+        do{
+            version = quote.version.load();
+            price = quote.price.load(memory_order_relaxed);
+            volatility = quote.volatility.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+        } while((version & 1) || version != quote.version.load(memory_order_relaxed));
+        stocks[stock].setQuote(price, volatility);
+        updates++;
+        int state = Running;
+        if(quote.state.compare_exchange_strong(state, Idle)) return;
+        // Dirty, a newer quote arrived while this one was applied
+        quote.state.store(Running);
+    }
+}
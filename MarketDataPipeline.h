@@ -0,0 +1,104 @@
+#ifndef AMERICANOPTIONSPRICING_MARKETDATAPIPELINE_H
+#define AMERICANOPTIONSPRICING_MARKETDATAPIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "SPMCQueue.h"
+#include "Stock.h"
+
+// Counters of a pipeline, see MarketDataPipeline::stats
+struct IngestStats {
+    std::size_t ticks = 0;      // ticks published
+    std::size_t updates = 0;    // quotes applied to stocks, the rest were superseded before a consumer got to them
+    std::size_t rejected = 0;   // lines that did not parse or named a symbol outside the universe
+};
+
+/**
+ * Streams ticks into a universe of stocks. A single producer thread publishes ticks and consumer threads apply them to
+ * the stocks, whose subscribers (typically Option chains, see subscribe) reprice on the consumer thread.
+ *
+ * Ticks are coalesced per stock: the producer overwrites the stock's latest quote and only queues the stock when no
+ * update for it is already pending, so a consumer always applies the newest quote and stale intermediate ticks are
+ * dropped. A stock is queued at most once and applied by one consumer at a time, so the queue always has room for a
+ * stock and a tick waits for at most one reprice of its stock in progress. The producer may still wait briefly for a
+ * consumer to release the slot it popped a lap earlier.
+ */
+class MarketDataPipeline {
+public:
+    // Constructor, starts the consumer threads. stocks must outlive the pipeline and keep its size.
+    explicit MarketDataPipeline(std::vector<Stock>& stocks, unsigned int consumers = 1);
+    // Stops the consumers, see close, and removes the chains subscribed through the pipeline from their stocks
+    ~MarketDataPipeline();
+    MarketDataPipeline(const MarketDataPipeline&) = delete;
+    MarketDataPipeline& operator=(const MarketDataPipeline&) = delete;
+
+    /**
+     * Reprices chain on every change to the stock of the same symbol, whether applied by the pipeline or made directly
+     * on the stock. Subscribe before publishing. The stock holds the subscription until the pipeline is destroyed, chain
+     * must outlive that subscription, so destroy the pipeline before the chain.
+     * @return false when the symbol is not in the universe
+     */
+    bool subscribe(Option& chain);
+
+    /**
+     * Publishes a tick, producer thread only
+     * @param volatility new volatility, 0 keeps the last one
+     * @return false when the symbol is not in the universe
+     */
+    bool publish(const std::string& symbol, double price, double volatility = 0.);
+
+    /**
+     * Publishes every tick read from in until end of stream, producer thread only. Reads one tick per line as
+     * "SYMBOL PRICE [VOLATILITY]"; blank lines and lines starting with # are skipped. Works with files, pipes and FIFOs
+     * a recorded session is replayed through.
+     * @return ticks published
+     */
+    std::size_t ingest(std::istream& in);
+
+    // Waits until every published tick has been applied, then stops the consumers. Called by the producer.
+    void close();
+
+    // Getters
+    IngestStats stats() const;
+
+private:
+    // Update state of a stock, moved between Idle, Queued and Running, with Dirty when a tick lands while Running
+    enum UpdateState : int { Idle, Queued, Running, Dirty };
+
+    // Latest quote of a stock, written by the producer under a sequence lock
+    struct Quote {
+        std::atomic<unsigned int> version;  // odd while the producer writes
+        std::atomic<double> price;
+        std::atomic<double> volatility;
+        std::atomic<int> state;
+    };
+
+    std::vector<Stock>& stocks;
+    std::unordered_map<std::string, std::size_t> index;     // stock by symbol
+    std::vector<std::pair<std::size_t, std::size_t>> subscriptions;     // stock and its handle, per subscribed chain
+    std::unique_ptr<Quote[]> quotes;
+    SPMCQueue<std::size_t> queue;                           // stocks with a quote to apply
+    std::vector<std::thread> consumers;
+    std::atomic<bool> closing;
+    std::atomic<int> sleepers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<std::size_t> ticks;
+    std::atomic<std::size_t> updates;
+    std::atomic<std::size_t> rejected;
+
+    void publish(std::size_t stock, double price, double volatility);
+    void consumerLoop();
+    void apply(std::size_t stock);
+};
+
+#endif //AMERICANOPTIONSPRICING_MARKETDATAPIPELINE_H
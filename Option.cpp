@@ -4,21 +4,118 @@
 
 #include "Option.h"
 #include "Price_American_PSOR.h"
+#include "Stock.h"
+#include "ThreadPool.h"
+#include "Tracing.h"
+#include <memory>
 
 using namespace std;
 
 Option::Option(const string& sym, const double stockPr, const double DTE, const double vol, bool computeGreeks = false)
-    : symbol(sym), stock_price(stockPr), days_to_exp(DTE), volatility(vol){
+    : symbol(sym), stock_price(stockPr), days_to_exp(DTE), volatility(vol), volModel(VolModel::Implied),
+      withGreeks(computeGreeks), strikeCount(0),
+      callGrid(new PSORWorkspace(gridNodes)), putGrid(new PSORWorkspace(gridNodes)), gridWidth(0.){
     // Constructor initialization list is used to initialize const members
+    setChains(computeGreeks, nullptr);
+}
+
+Option::Option(const string& sym, const double stockPr, const double DTE, const double vol, bool computeGreeks,
+               ThreadPool& pool)
+    : symbol(sym), stock_price(stockPr), days_to_exp(DTE), volatility(vol), volModel(VolModel::Implied),
+      withGreeks(computeGreeks), strikeCount(0),
+      callGrid(new PSORWorkspace(gridNodes)), putGrid(new PSORWorkspace(gridNodes)), gridWidth(0.){
+    setChains(computeGreeks, &pool);
+}
+
+Option::Option(const string& sym, const double stockPr, const double DTE, const VolSurface& surface, VolModel model,
+               bool computeGreeks)
+    : symbol(sym), stock_price(stockPr), days_to_exp(DTE), volatility(surface.vol(stockPr, DTE)),
+      surface(make_shared<VolSurface>(surface)), volModel(model), withGreeks(computeGreeks), strikeCount(0),
+      callGrid(new PSORWorkspace(gridNodes)), putGrid(new PSORWorkspace(gridNodes)), gridWidth(0.){
+    setChains(computeGreeks, nullptr);
+}
+
+/**
+ * Prices the strike chain, serially or with the call and put solves running concurrently on pool
+ */
+void Option::setChains(bool computeGreeks, ThreadPool* pool) {
+    withGreeks = computeGreeks;
     setStrikeChain();
-    setCallChain();
-    setPutChain();
-    if(computeGreeks){
+    solveChains(pool);
+}
+
+/**
+ * Solves the call and put grids for the current strike chain and reads the chains off them
+ */
+void Option::solveChains(ThreadPool* pool) {
+    gridWidth = chainConfig(stock_price).spaceMax;
+    if(pool){
+        pool->parallelFor(2, [this](size_t i){
+            if(i == 0) setCallChain();
+            else setPutChain();
+        });
+    }
+    else{
+        setCallChain();
+        setPutChain();
+    }
+    if(withGreeks){
+        setDelta();
+        setGamma();
+        setTheta();
+    }
+}
+
+/**
+ * Reads prices, and greeks when computed, at the current spot off the cached grids
+ */
+void Option::readChains() {
+    readChain(*callGrid, true, callResults, column(CallColumn));
+    readChain(*putGrid, false, putResults, column(PutColumn));
+    if(withGreeks){
         setDelta();
         setGamma();
+        setTheta();
+    }
+}
+
+void Option::readChain(const PSORWorkspace& grid, bool type, vector<PricingResult>& results, double* prices) {
+    const double* strikes = column(StrikeColumn);
+    results.resize(strikeCount);
+    for(size_t k = 0; k < strikeCount; k++){
+        results[k] = readNormalizedGrid(grid, stock_price, strikes[k], type);
+        prices[k] = results[k].price;
     }
 }
 
+double* Option::column(ChainColumn c) {
+    return chain.data() + c * strikeCount;
+}
+
+const double* Option::column(ChainColumn c) const {
+    return chain.data() + c * strikeCount;
+}
+
+DoubleSpan Option::columnSpan(ChainColumn c) const {
+    return DoubleSpan{column(c), strikeCount};
+}
+
+ChainView Option::getChain() const {
+    ChainView view;
+    view.strike = columnSpan(StrikeColumn);
+    view.call = columnSpan(CallColumn);
+    view.put = columnSpan(PutColumn);
+    // Greek columns are only filled when the chain computes greeks
+    DoubleSpan none{column(CallDeltaColumn), 0};
+    view.callDelta = withGreeks ? columnSpan(CallDeltaColumn) : none;
+    view.putDelta = withGreeks ? columnSpan(PutDeltaColumn) : none;
+    view.callGamma = withGreeks ? columnSpan(CallGammaColumn) : none;
+    view.putGamma = withGreeks ? columnSpan(PutGammaColumn) : none;
+    view.callTheta = withGreeks ? columnSpan(CallThetaColumn) : none;
+    view.putTheta = withGreeks ? columnSpan(PutThetaColumn) : none;
+    return view;
+}
+
 /**
  * Stores call and put chains as straddle (call, strike, put)
  * @return 3 dimensional vector containing call, strike, and put chain
@@ -26,12 +123,12 @@ Option::Option(const string& sym, const double stockPr, const double DTE, const
 vector<vector<double>> Option::getOptionChain() const{
     std::vector<std::vector<double>> straddleChain;
     // Iterate through all chains and construct the straddle for each strike price
-    for (size_t i = 0; i < strikeChain.size(); ++i) {
+    for (size_t i = 0; i < strikeCount; ++i) {
         std::vector<double> straddleAtK;
         // Get the strike price, call price, and put price for the current index
-        double put_price = putChain[i];
-        double strike = strikeChain[i];
-        double call_price = callChain[i];
+        double put_price = column(PutColumn)[i];
+        double strike = column(StrikeColumn)[i];
+        double call_price = column(CallColumn)[i];
         // Add the strike, call price, and put price to the straddle vector
         straddleAtK.push_back(put_price);
         straddleAtK.push_back(strike);
@@ -56,31 +153,72 @@ double Option::getDTE() const {
 }
 
 double Option::getVolatility() const {
-    return volatility;
+    return surface ? surface->vol(stock_price, days_to_exp) : volatility;
 }
 
-void Option::addStrike(double strike) {
-    strikeChain.push_back(strike);
+bool Option::insideChain(double stockPr) const {
+    return strikeCount > 0 && stockPr >= column(StrikeColumn)[0] && stockPr <= column(StrikeColumn)[strikeCount - 1];
 }
 
-void Option::addCall(double callPrice) {
-    callChain.push_back(callPrice);
+/**
+ * The strike-normalized grids only depend on the spot through their width, which covers the lowest strike. A move that
+ * a new solve would give the same width is repriced off the cached grids and matches that solve exactly; a wider move
+ * solves again. The chain was laid out around the old spot though, so once the spot leaves the listed strikes it is
+ * rebuilt and solved. A surface chain solves each strike on its own grid, which is not kept, so it always solves again.
+ */
+bool Option::isTrustedSpot(double stockPr) const {
+    return !surface && insideChain(stockPr) && chainConfig(stockPr).spaceMax == gridWidth;
 }
 
-void Option::addPut(double putPrice) {
-    putChain.push_back(putPrice);
+/**
+ * Grid settings of the chain at spot stockPr, wide enough to read its lowest strike
+ */
+PricingConfig Option::chainConfig(double stockPr) const {
+    return coveringConfig(PricingConfig(), stockPr / column(StrikeColumn)[0]);
 }
 
-vector<double> &Option::getStrikeChain() {
-    return strikeChain;
+void Option::setStockPrice(double stockPr) {
+    stock_price = stockPr;
+    if(isTrustedSpot(stockPr)){
+        readChains();
+        return;
+    }
+    if(!insideChain(stockPr)) setStrikeChain();
+    solveChains(nullptr);
 }
 
-vector<double> &Option::getCallChain() {
-    return callChain;
+void Option::setVolatility(double vol) {
+    // The grids depend on volatility and expiry, solve again for the same strikes
+    volatility = vol;
+    surface.reset();
+    solveChains(nullptr);
 }
 
-vector<double> &Option::getPutChain() {
-    return putChain;
+void Option::setVolSurface(const VolSurface& surface, VolModel model) {
+    this->surface = make_shared<VolSurface>(surface);
+    volModel = model;
+    solveChains(nullptr);
+}
+
+void Option::setQuote(double stockPr, double vol) {
+    if(surface || vol == volatility){
+        setStockPrice(stockPr);
+        return;
+    }
+    stock_price = stockPr;
+    volatility = vol;
+    if(!insideChain(stockPr)) setStrikeChain();
+    solveChains(nullptr);
+}
+
+void Option::setDTE(double DTE) {
+    days_to_exp = DTE;
+    solveChains(nullptr);
+}
+
+void Option::addStrike(size_t i, double strike) {
+    column(StrikeColumn)[i] = strike;
+    strikeTicks[i] = llround(strike * strikeTicksPerUnit);
 }
 
 double Option::setStrikeStep(double currStrike, int &chainLength, int &stepStart) {
@@ -108,88 +246,167 @@ double Option::setStrikeStep(double currStrike, int &chainLength, int &stepStart
 }
 
 void Option::setStrikeChain() {
+    TraceSpan span("setStrikeChain", "chain", symbol.c_str());
     double currStrike = double(nearbyint(stock_price));
     int chainLength = 51;
     int stepStart = 1;
     double strikeStep = setStrikeStep(currStrike, chainLength, stepStart);
 
+    // Room for every column, reused when the chain keeps its length
+    strikeCount = size_t(chainLength - stepStart + 1);
+    chain.assign(ChainColumns * strikeCount, 0.);
+    strikeTicks.resize(strikeCount);
     // Generate strike chain
     for (int i = stepStart; i <= chainLength ; i++){
-        addStrike(currStrike + (i * strikeStep) - int((chainLength / 2) * strikeStep));
+        addStrike(size_t(i - stepStart), currStrike + (i * strikeStep) - int((chainLength / 2) * strikeStep));
     }
 }
 
 void Option::setCallChain(){
-    for(auto K: getStrikeChain()) addCall(priceAmericanPSOR(stock_price, days_to_exp, volatility, K, 0.05, 1));
+    TraceSpan span("setCallChain", "chain", symbol.c_str());
+    if(surface){
+        solveSurfaceChain(1, callResults, column(CallColumn));
+        return;
+    }
+    // One PDE solve prices every strike, greeks come from the same grid, which is kept for repricing
+    solveNormalizedGrid(*callGrid, days_to_exp, volatility, 0.05, 1, column(StrikeColumn)[strikeCount - 1],
+                        PSORSolver::PSOR, nullptr, chainConfig(stock_price));
+    readChain(*callGrid, 1, callResults, column(CallColumn));
 }
 
 void Option::setPutChain(){
-    for(auto K: getStrikeChain()) addPut(priceAmericanPSOR(stock_price, days_to_exp, volatility, K, 0.05, 0));
+    TraceSpan span("setPutChain", "chain", symbol.c_str());
+    if(surface){
+        solveSurfaceChain(0, putResults, column(PutColumn));
+        return;
+    }
+    solveNormalizedGrid(*putGrid, days_to_exp, volatility, 0.05, 0, column(StrikeColumn)[strikeCount - 1],
+                        PSORSolver::PSOR, nullptr, chainConfig(stock_price));
+    readChain(*putGrid, 0, putResults, column(PutColumn));
 }
 
-double Option::getCallAtStrike(double strike) const {
-    for(int i = 0; i < strikeChain.size(); i++){
-        if (strikeChain[i] == strike){
-            return callChain[i];
-        }
+/**
+ * Prices the chain off the surface, one grid per strike since strikes at different volatilities share none
+ */
+void Option::solveSurfaceChain(bool type, vector<PricingResult>& results, double* prices) {
+    const double* strikes = column(StrikeColumn);
+    priceAmericanChainSurface(stock_price, days_to_exp, *surface, vector<double>(strikes, strikes + strikeCount), 0.05,
+                              type, results, volModel);
+    for(size_t k = 0; k < strikeCount; k++) prices[k] = results[k].price;
+}
+
+/**
+ * Looks strike up in the index, reading it off the grid solved for the chain when it is not listed. The grid is
+ * normalized by strike, so any strike whose S / K lies on it is priced as accurately as a listed one.
+ */
+StrikeStatus Option::priceAtStrike(double strike, bool type, double& price) const {
+    const vector<PricingResult>& results = type ? callResults : putResults;
+    long long ticks = llround(strike * strikeTicksPerUnit);
+    auto found = lower_bound(strikeTicks.begin(), strikeTicks.end(), ticks);
+    if(found != strikeTicks.end() && *found == ticks){
+        price = results[found - strikeTicks.begin()].price;
+        return StrikeStatus::Listed;
     }
-    cout << "Strike " << strike << " not in list\n";
-    return -1;
+    if(strike <= 0.) return StrikeStatus::OutOfRange;
+    if(surface){
+        if(stock_price / strike > gridWidth) return StrikeStatus::OutOfRange;
+        // No grid is shared across strikes, solve this one
+        vector<PricingResult> offChain;
+        priceAmericanChainSurface(stock_price, days_to_exp, *surface, {strike}, 0.05, type, offChain, volModel);
+        price = offChain[0].price;
+        return StrikeStatus::OffChain;
+    }
+    const PSORWorkspace& grid = type ? *callGrid : *putGrid;
+    if(stock_price / strike > gridReach(grid)) return StrikeStatus::OutOfRange;
+    price = readNormalizedGrid(grid, stock_price, strike, type).price;
+    return StrikeStatus::OffChain;
 }
-double Option::getPutAtStrike(double strike) const {
-    for(int i = 0; i < strikeChain.size(); i++){
-        if (strikeChain[i] == strike){
-            return putChain[i];
-        }
+
+StrikeStatus Option::getCallAtStrike(double strike, double& price) const {
+    return priceAtStrike(strike, true, price);
+}
+
+StrikeStatus Option::getPutAtStrike(double strike, double& price) const {
+    return priceAtStrike(strike, false, price);
+}
+
+void Option::getCallsAtStrikes(const double* strikes, size_t count, double* prices, StrikeStatus* status) const {
+    for(size_t i = 0; i < count; i++){
+        prices[i] = NAN;
+        status[i] = priceAtStrike(strikes[i], true, prices[i]);
+    }
+}
+
+void Option::getPutsAtStrikes(const double* strikes, size_t count, double* prices, StrikeStatus* status) const {
+    for(size_t i = 0; i < count; i++){
+        prices[i] = NAN;
+        status[i] = priceAtStrike(strikes[i], false, prices[i]);
     }
-    cout << "Strike " << strike << " not in list\n";
-    return -1;
 }
 
 /**
- * Computes and returns vector with respective delta of option chain (call, put)
+ * Stores delta of option chain (call, put), read off the PDE grids
  */
 void Option::setDelta() {
-    // Compute
-    double epsilon = pow(10, -2);
-    double dS = stock_price + epsilon;
-    Option dO = Option(symbol, dS, days_to_exp, volatility);
-    // result vector
-    vector<double> dC = dO.getCallChain();
-    vector<double> dP = dO.getPutChain();
-    for(int i = 0; i < strikeChain.size(); i++){
-        double callDelta = (dC[i] - callChain[i]) / dS;
-        double putDelta = (dP[i] - putChain[i]) / dS;
-        vector<double> currDelta = {callDelta, putDelta};
-        delta.push_back(currDelta);
+    TraceSpan span("setDelta", "chain", symbol.c_str());
+    for(size_t i = 0; i < strikeCount; i++){
+        column(CallDeltaColumn)[i] = callResults[i].delta;
+        column(PutDeltaColumn)[i] = putResults[i].delta;
     }
 }
 
 /**
- * Computes and returns vector with respective gamma of option chain (call, put)
- * Requires: delta vector must be already calculated
+ * Stores gamma of option chain (call, put), read off the PDE grids
  */
 void Option::setGamma() {
-    // Compute
-    double epsilon = pow(10, -2);
-    double dS = stock_price - epsilon;
-    Option dO = Option(symbol, dS, days_to_exp, volatility);
-    // result vector
-    vector<double> dC = dO.getCallChain();
-    vector<double> dP = dO.getPutChain();
-    for(int i = 0; i < strikeChain.size(); i++){
-        vector<double> currDelta = delta[i];
-        double callGamma = (((dC[i] + callChain[i]) / dS) + currDelta[0]) / dS;
-        double putGamma = (((dP[i] - putChain[i]) / dS) + currDelta[1]) / dS;
-        vector<double> currGamma = {callGamma, putGamma};
-        gamma.push_back(currGamma);
+    TraceSpan span("setGamma", "chain", symbol.c_str());
+    for(size_t i = 0; i < strikeCount; i++){
+        column(CallGammaColumn)[i] = callResults[i].gamma;
+        column(PutGammaColumn)[i] = putResults[i].gamma;
+    }
+}
+
+/**
+ * Stores theta of option chain (call, put) per year, read off the last two PDE time slices
+ */
+void Option::setTheta() {
+    TraceSpan span("setTheta", "chain", symbol.c_str());
+    for(size_t i = 0; i < strikeCount; i++){
+        column(CallThetaColumn)[i] = callResults[i].theta;
+        column(PutThetaColumn)[i] = putResults[i].theta;
     }
 }
 
-vector<std::vector<double>> &Option::getDelta() {
-    return delta;
+vector<vector<double>> Option::getColumnPairs(ChainColumn callColumn, ChainColumn putColumn) const {
+    vector<vector<double>> pairs;
+    if(!withGreeks) return pairs;
+    for(size_t i = 0; i < strikeCount; i++) pairs.push_back({column(callColumn)[i], column(putColumn)[i]});
+    return pairs;
 }
 
-vector<std::vector<double>> &Option::getGamma() {
-    return delta;
-}
\ No newline at end of file
+vector<vector<double>> Option::getDelta() const {
+    return getColumnPairs(CallDeltaColumn, PutDeltaColumn);
+}
+
+vector<vector<double>> Option::getGamma() const {
+    return getColumnPairs(CallGammaColumn, PutGammaColumn);
+}
+
+vector<vector<double>> Option::getTheta() const {
+    return getColumnPairs(CallThetaColumn, PutThetaColumn);
+}
+
+vector<Option> priceOptionChains(const vector<Stock>& stocks, const double DTE, bool computeGreeks, ThreadPool& pool) {
+    // Each chain is built in its own slot so the output order never depends on scheduling
+    vector<unique_ptr<Option>> built(stocks.size());
+    pool.parallelFor(stocks.size(), [&](size_t i){
+        const Stock& stock = stocks[i];
+        const string symbol = stock.getSymbol();
+        TraceSpan span("Option", "chain", symbol.c_str());
+        built[i].reset(new Option(symbol, stock.getPrice(), DTE, stock.getVolatility(), computeGreeks, pool));
+    });
+    vector<Option> options;
+    options.reserve(stocks.size());
+    for(auto& option: built) options.push_back(std::move(*option));
+    return options;
+}
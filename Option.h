@@ -9,50 +9,141 @@
 #include <algorithm>
 #include <cmath>
 #include <iostream>
+#include <memory>
+#include "BatchPricing.h"
+#include "Price_American_PSOR.h"
+#include "VolSurface.h"
+
+class Stock;
+class ThreadPool;
+
+// Strikes are keyed in integer ticks of a cent, so lookups never compare doubles for equality
+const double strikeTicksPerUnit = 100.;
+
+// Outcome of a strike lookup
+enum class StrikeStatus {
+    Listed,         // strike is on the chain
+    OffChain,       // not on the chain, priced off the chain's PDE grid
+    OutOfRange      // outside the grid, no price
+};
+
+/**
+ * Non-owning view of size contiguous doubles
+ */
+struct DoubleSpan {
+    const double* data;
+    std::size_t size;
+
+    const double& operator[](std::size_t i) const { return data[i]; }
+    const double* begin() const { return data; }
+    const double* end() const { return data + size; }
+};
+
+/**
+ * Columns of an option chain, entry i of every column belongs to strike i. The columns are slices of one buffer owned by
+ * the Option, so reading them allocates nothing; they stay valid until the chain is repriced or rebuilt. Greek columns
+ * are empty unless the chain was built with computeGreeks.
+ */
+struct ChainView {
+    DoubleSpan strike;
+    DoubleSpan call;
+    DoubleSpan put;
+    DoubleSpan callDelta;
+    DoubleSpan putDelta;
+    DoubleSpan callGamma;
+    DoubleSpan putGamma;
+    DoubleSpan callTheta;
+    DoubleSpan putTheta;
+};
 
 class Option {
 public:
-    // Constructor
+    // Constructors, the pooled constructor prices the call and put chains concurrently on pool
     Option(const std::string& sym, const double stockPr, const double DTE, const double vol, bool computeGreeks);
+    Option(const std::string& sym, const double stockPr, const double DTE, const double vol, bool computeGreeks,
+           ThreadPool& pool);
+    // Chain priced off a volatility surface, read per strike or as a local volatility depending on model
+    Option(const std::string& sym, const double stockPr, const double DTE, const VolSurface& surface, VolModel model,
+           bool computeGreeks);
 
     // Getters
     std::string getSymbol() const;
     double getStockPrice() const;
     double getDTE() const;
-    double getVolatility() const;
-    std::vector<std::vector<double>> getOptionChain() const;      // Return entire option chain as Straddle
-    double getCallAtStrike(double strike) const;                  // Return call at specific strike
-    double getPutAtStrike(double strike) const;                   // Return put at specific strike
-    std::vector<std::vector<double>>& getDelta();
-    std::vector<std::vector<double>>& getGamma();
+    double getVolatility() const;                                 // At the money volatility of a surface chain
+    ChainView getChain() const;                                   // Chain columns, without copying
+    std::vector<std::vector<double>> getOptionChain() const;      // Copy of the chain as Straddle
+    StrikeStatus getCallAtStrike(double strike, double& price) const;   // Call at specific strike
+    StrikeStatus getPutAtStrike(double strike, double& price) const;    // Put at specific strike
+    // Bulk lookups, price[i] and status[i] for strikes[i]; out of range strikes get a NaN price
+    void getCallsAtStrikes(const double* strikes, std::size_t count, double* prices, StrikeStatus* status) const;
+    void getPutsAtStrikes(const double* strikes, std::size_t count, double* prices, StrikeStatus* status) const;
+    std::vector<std::vector<double>> getDelta() const;            // Copies of the greek columns as (call, put)
+    std::vector<std::vector<double>> getGamma() const;
+    std::vector<std::vector<double>> getTheta() const;
+
+    // Setters, a spot move inside the trusted region reprices off the cached grids without solving the PDE
+    void setStockPrice(double stockPr);
+    void setVolatility(double vol);              // Flat volatility, replaces a surface
+    void setVolSurface(const VolSurface& surface, VolModel model);
+    void setDTE(double DTE);
+    // Spot and volatility together, solving at most once. A surface chain keeps its surface and only takes the spot.
+    void setQuote(double stockPr, double vol);
+    bool isTrustedSpot(double stockPr) const;     // Whether a move to stockPr can be repriced off the cached grids
 
 private:
     const std::string symbol;
-    const double stock_price;
-    const double days_to_exp;
-    const double volatility;
-    std::vector<double> strikeChain;
-    std::vector<double> callChain;
-    std::vector<double> putChain;
+    double stock_price;
+    double days_to_exp;
+    double volatility;
+    std::shared_ptr<const VolSurface> surface;  // Replaces volatility when set
+    VolModel volModel;
+    bool withGreeks;
+    // Chain columns, back to back in one buffer
+    enum ChainColumn {
+        StrikeColumn, CallColumn, PutColumn, CallDeltaColumn, PutDeltaColumn, CallGammaColumn, PutGammaColumn,
+        CallThetaColumn, PutThetaColumn, ChainColumns
+    };
+    std::vector<double> chain;
+    std::size_t strikeCount;
+    std::vector<long long> strikeTicks;     // strike column in ticks, sorted, the lookup index
+    std::vector<PricingResult> callResults;
+    std::vector<PricingResult> putResults;
+    std::unique_ptr<PSORWorkspace> callGrid;    // Last solved strike-normalized grids, read again on spot moves
+    std::unique_ptr<PSORWorkspace> putGrid;
+    double gridWidth;                           // S_max of the last solve, in units of strike
 
     // Option chain management
-    void addStrike(double strike);
-    void addCall(double callPrice);
-    void addPut(double putPrice);
+    double* column(ChainColumn c);
+    const double* column(ChainColumn c) const;
+    DoubleSpan columnSpan(ChainColumn c) const;
+    void addStrike(std::size_t i, double strike);
     double setStrikeStep(double currStrike, int &chainLength, int &stepStart);
+    bool insideChain(double stockPr) const;
+    PricingConfig chainConfig(double stockPr) const;
+    StrikeStatus priceAtStrike(double strike, bool type, double& price) const;
     void setStrikeChain();
     void setCallChain();
     void setPutChain();
-    std::vector<double>& getStrikeChain();
-    std::vector<double>& getCallChain();
-    std::vector<double>& getPutChain();
+    void setChains(bool computeGreeks, ThreadPool* pool);
+    void solveChains(ThreadPool* pool);
+    void readChains();
+    void readChain(const PSORWorkspace& grid, bool type, std::vector<PricingResult>& results, double* prices);
+    void solveSurfaceChain(bool type, std::vector<PricingResult>& results, double* prices);
+    std::vector<std::vector<double>> getColumnPairs(ChainColumn callColumn, ChainColumn putColumn) const;
 
-    // Option Greeks calculations
-    std::vector<std::vector<double>> delta;
-    std::vector<std::vector<double>> gamma;
+    // Option Greeks, read off the same PDE grids as the prices
     void setDelta();
     void setGamma();
+    void setTheta();
 
 };
 
+/**
+ * Builds the option chain of every stock at the given expiry, spreading the chains and their call and put solves across
+ * pool. Results are identical to constructing each Option serially, whatever the pool size.
+ */
+std::vector<Option> priceOptionChains(const std::vector<Stock>& stocks, const double DTE, bool computeGreeks,
+                                      ThreadPool& pool);
+
 #endif //AMERICANOPTIONSPRICING_OPTION_H
@@ -5,6 +5,11 @@
 #include <iostream>
 #include "Price_American_PSOR.h"
 #include <fstream>  // Include for file output
+#include <cassert>
+#include "AllocationCounter.h"
+#include "ThreadPool.h"
+#include "Tracing.h"
+#include "VolSurface.h"
 
 using namespace std;
 using namespace Eigen;
@@ -33,124 +38,671 @@ void exportMatrixToCSV(const MatrixXd& matrix, const string& filename) {
     }
 }
 
+PSORWorkspace::PSORWorkspace(int N)
+    : storage(11 * (N + 1) + redBlackChunks(N)), L(N + 1), M1(N + 1), M2(N + 1),
+      S_i(storage.data(), N + 1), w(storage.data() + (N + 1), N + 1), wOld(storage.data() + 2 * (N + 1), N + 1),
+      v(storage.data() + 3 * (N + 1), N + 1), vPrev(storage.data() + 4 * (N + 1), N + 1),
+      d(storage.data() + 5 * (N + 1), N + 1),
+      elimCoef(storage.data() + 6 * (N + 1), N + 1), elimRhs(storage.data() + 7 * (N + 1), N + 1),
+      obstacle(storage.data() + 8 * (N + 1), N + 1), invDiag(storage.data() + 9 * (N + 1), N + 1),
+      nodeVol(storage.data() + 10 * (N + 1), N + 1),
+      chunkError(storage.data() + 11 * (N + 1), redBlackChunks(N)), dt(0.), r(0.), discount(1.), stats(){
+}
+
+/**
+ * Exercise value, S - K for a call and K - S for a put. The option type is a template parameter so the solver loops
+ * below are compiled once per type and carry no branch on it.
+ */
+template<bool Call>
+static inline double exerciseValue(const double S, const double K){
+    return Call ? S - K : K - S;
+}
+
 double payoff(double S, double K, bool type){
-    if(type){
-        // return call option payoff
-        return max(S - K, 0.);
-    }
-    else{
-        // return put option payoff
-        return max(K - S, 0.);
+    // return call or put option payoff
+    return type ? max(exerciseValue<true>(S, K), 0.) : max(exerciseValue<false>(S, K), 0.);
+}
+
+/**
+ * Black-Scholes operator L = sig^2 S^2 / 2 d2/dS2 + r S d/dS - r on the interior rows of the (possibly non-uniform)
+ * nodes S_i, with volatility sig(i) at node i. Depends on the contract only, the time step operators are formed from it
+ * by initMatrix.
+ */
+void initOperator(TridiagonalMatrix& L, const Ref<const VectorXd>& S_i, const Ref<const VectorXd>& sig, int N, double r){
+    for(int row = 1; row < N; row++) {
+        double hDown = S_i(row) - S_i(row - 1);
+        double hUp = S_i(row + 1) - S_i(row);
+        double diffusion = pow(sig(row) * S_i(row), 2);
+        double drift = r * S_i(row);
+        // Three point central differences, second order on a smoothly stretched grid
+        double a = (diffusion - drift * hUp) / (hDown * (hDown + hUp));
+        double c = (diffusion + drift * hDown) / (hUp * (hDown + hUp));
+        L.lower(row) = a;
+        L.diag(row) = -a - c - r;
+        L.upper(row) = c;
     }
 }
 
-void initMatrix(MatrixXd& M, int N, double theta, double sig, double r, double dt){
-    M(0,0) = 1;
+/**
+ * Theta scheme for the operator L: M1 = theta L - I / dt and M2 = -(1 - theta) L - I / dt, with Dirichlet rows at both
+ * ends of M1, and the reciprocal of M1's diagonal for the sweeps
+ */
+void initMatrix(TridiagonalMatrix& M1, TridiagonalMatrix& M2, Ref<VectorXd> invDiag, const TridiagonalMatrix& L, int N,
+                double theta, double dt){
+    M1.diag(0) = 1;
     for(int row = 1; row < N; row++) {
-        double a = 0.5 * theta * (pow(sig * row, 2) - (r * row));
-        double b = -0.5 * (pow(sig * row, 2) + r) - 1. / dt;
-        double c = 0.5 * theta * (pow(sig * row, 2) + (r * row));
-        M(row, row - 1) = a;
-        M(row, row) = b;
-        M(row, row + 1) = c;
+        M1.lower(row) = theta * L.lower(row);
+        M1.diag(row) = theta * L.diag(row) - 1. / dt;
+        M1.upper(row) = theta * L.upper(row);
+        M2.lower(row) = -(1. - theta) * L.lower(row);
+        M2.diag(row) = -(1. - theta) * L.diag(row) - 1. / dt;
+        M2.upper(row) = -(1. - theta) * L.upper(row);
     }
-    M(N,N) = 1;
+    M1.diag(N) = 1;
+    for(int row = 0; row <= N; row++) invDiag(row) = 1. / M1.diag(row);
 }
 
-void initPrev(VectorXd& d, VectorXd w, MatrixXd M1, double K, int N, int M, int t, double dt, double r){
-    d(0) = K * exp(-r * (M - t) * dt);
+/**
+ * Right hand side d = M2 * w of time step t
+ * @tparam Implicit fully implicit step (theta = 1), M2 = -I / dt is diagonal and its off-diagonals are skipped
+ */
+template<bool Implicit>
+static void initPrev(Ref<VectorXd> d, const Ref<const VectorXd>& w, const TridiagonalMatrix& M2, int N, double low, double high){
+    d(0) = low;
     for(int i = 1; i < N; i++){
-        d(i) = -M1(i, i - 1) * w(i - 1) - (M1(i, i) + 2./dt) * w(i) - M1(i, i + 1) * w(i + 1);
+        if(Implicit){
+            d(i) = M2.diag(i) * w(i);
+        }
+        else{
+            d(i) = M2.lower(i) * w(i - 1) + M2.diag(i) * w(i) + M2.upper(i) * w(i + 1);
+        }
     }
-    d(N) = 0;
+    d(N) = high;
 }
 
-void computeSOR(VectorXd& v, const MatrixXd M1, const VectorXd d, const VectorXd S_i, const int maxIter, const int N,
-                const double weight, const double K, const double err, const bool type){
-    int cnt = 0;
-    while (cnt < maxIter){
+/**
+ * Projected SOR solve of the time step
+ * @param held nodes at the exercise end left on the payoff until the others converge, see warmStart. They are then
+ * relaxed once, and only swept with the rest of the grid if that moves them.
+ * @param residual output, squared change of the last sweep, converged when below err
+ * @tparam Call option type, sets the end of the grid the held nodes are at
+ * @return number of sweeps performed
+ */
+template<bool Call>
+static int computeSOR(Ref<VectorXd> v, const TridiagonalMatrix& M1, const Ref<const VectorXd>& invDiag,
+                      const Ref<const VectorXd>& d, const Ref<const VectorXd>& obstacle, const int maxIter, const int N,
+                      const double weight, const double err, const int held, double& residual){
+    // One sweep over nodes first to last
+    auto sweep = [&](int first, int last){
         double error = 0.;
-        double y = (d(0) - M1(0,1) * v(0)) / M1(0,0);
-        y = v(0) + weight * (y - v(0));
-        if(type){
-            y = max(y, S_i(0) - K);
+        if(first == 0){
+            double y = (d(0) - M1.upper(0) * v(0)) * invDiag(0);
+            y = v(0) + weight * (y - v(0));
+            y = max(y, obstacle(0));
+            error += pow(y - v(0), 2);
+            v(0) = y;
         }
-        else{
-            y = max(y, K - S_i(0));
-        }
-        error += pow(y - v(0), 2);
-        v(0) = y;
-        for(int i = 1; i < N; i++){
-            double y = (d(i) - M1(i, i - 1) * v(i - 1) - M1(i, i + 1) * v(i + 1)) / M1(i, i);
+        for(int i = max(first, 1); i < min(last + 1, N); i++){
+            double y = (d(i) - M1.lower(i) * v(i - 1) - M1.upper(i) * v(i + 1)) * invDiag(i);
             y = v(i) + weight * (y - v(i));
-            if(type){
-                y = max(y, S_i(i) - K);
-            }
-            else{
-                y = max(y, K - S_i(i));
-            }
+            y = max(y, obstacle(i));
             error += pow(y - v(i), 2);
             v(i) = y;
         }
-        y = (d(N) - M1(N, N - 1) * v(N - 1)) / M1(N,N);
-        y = v(N) + weight * (y - v(N));
-        if(type){
-            y = max(y, S_i(N) - K);
+        if(last == N){
+            double y = (d(N) - M1.lower(N) * v(N - 1)) * invDiag(N);
+            y = v(N) + weight * (y - v(N));
+            y = max(y, obstacle(N));
+            error += pow(y - v(N), 2);
+            v(N) = y;
         }
-        else{
-            y = max(y, K - S_i(N));
+        return error;
+    };
+    // Nodes swept, the held ones at the exercise end stay on the payoff
+    int first = Call ? 0 : held;
+    int last = Call ? N - held : N;
+    int cnt = 0;
+    while (cnt < maxIter){
+        double error = sweep(first, last);
+        residual = error;
+        if(error < err){
+            if(first == 0 && last == N){
+                return cnt + 1;
+            }
+            // Converged around the held nodes, check they stay on the payoff before sweeping the whole grid again
+            double heldError = Call ? sweep(last + 1, N) : sweep(0, first - 1);
+            residual = error + heldError;
+            if(residual < err){
+                return cnt + 1;
+            }
+            first = 0;
+            last = N;
         }
+        cnt++;
+    }
+    return maxIter;
+}
+
+int redBlackChunks(int N) {
+    return max(1, (N - 1 + redBlackChunkNodes - 1) / redBlackChunkNodes);
+}
+
+/**
+ * Updates the interior nodes of one colour in [begin, end), using next(i) as scratch. Nodes of a colour only read nodes
+ * of the other colour, so the update loop carries no dependency and vectorizes.
+ * @return sum of squared changes
+ */
+static double redBlackHalfSweep(Ref<VectorXd> v, const TridiagonalMatrix& M1, const Ref<const VectorXd>& invDiag,
+                                const Ref<const VectorXd>& d, const Ref<const VectorXd>& obstacle, Ref<VectorXd> next,
+                                const int begin, const int end, const double weight){
+    double* vp = v.data();
+    double* np = next.data();
+    const double* lower = M1.lower.data();
+    const double* inv = invDiag.data();
+    const double* upper = M1.upper.data();
+    const double* dp = d.data();
+    const double* ob = obstacle.data();
+    for(int i = begin; i < end; i += 2){
+        double y = (dp[i] - lower[i] * vp[i - 1] - upper[i] * vp[i + 1]) * inv[i];
+        y = vp[i] + weight * (y - vp[i]);
+        np[i] = max(y, ob[i]);
+    }
+    double error = 0.;
+    for(int i = begin; i < end; i += 2){
+        error += (np[i] - vp[i]) * (np[i] - vp[i]);
+        vp[i] = np[i];
+    }
+    return error;
+}
+
+/**
+ * Red-black projected SOR: every sweep updates the odd nodes, then the even nodes. Each half sweep is split into fixed
+ * chunks of redBlackChunkNodes nodes which run on pool when there is more than one; chunk errors are summed in chunk
+ * order so the result does not depend on the number of threads.
+ * @param residual output, squared change of the last sweep
+ * @return number of sweeps performed
+ */
+static int computeRedBlackSOR(Ref<VectorXd> v, const TridiagonalMatrix& M1, const Ref<const VectorXd>& invDiag,
+                              const Ref<const VectorXd>& d, const Ref<const VectorXd>& obstacle, Ref<VectorXd> next,
+                              Ref<VectorXd> chunkError, const int maxIter, const int N, const double weight,
+                              const double err, ThreadPool* pool, double& residual){
+    const int chunks = redBlackChunks(N);
+    auto halfSweep = [&](int colour){
+        auto runChunk = [&](size_t c){
+            int begin = 1 + int(c) * redBlackChunkNodes;
+            int end = min(N, begin + redBlackChunkNodes);
+            // First node of this colour in the chunk, chunks start on an odd node
+            chunkError(c) = redBlackHalfSweep(v, M1, invDiag, d, obstacle, next, begin + (colour == 1 ? 0 : 1), end,
+                                              weight);
+        };
+        if(pool && chunks > 1) pool->parallelFor(size_t(chunks), runChunk);
+        else for(int c = 0; c < chunks; c++) runChunk(size_t(c));
+        double error = 0.;
+        for(int c = 0; c < chunks; c++) error += chunkError(c);
+        return error;
+    };
+    int cnt = 0;
+    while (cnt < maxIter){
+        // Odd nodes
+        double error = halfSweep(1);
+        // Even nodes, with the boundaries
+        double y = (d(0) - M1.upper(0) * v(0)) * invDiag(0);
+        y = v(0) + weight * (y - v(0));
+        y = max(y, obstacle(0));
+        error += pow(y - v(0), 2);
+        v(0) = y;
+        error += halfSweep(0);
+        y = (d(N) - M1.lower(N) * v(N - 1)) * invDiag(N);
+        y = v(N) + weight * (y - v(N));
+        y = max(y, obstacle(N));
         error += pow(y - v(N), 2);
         v(N) = y;
+        residual = error;
         if(error < err){
-            break;
+            return cnt + 1;
         }
         cnt++;
     }
+    return maxIter;
+}
+
+double estimateSORWeight(const TridiagonalMatrix& M1, const int N){
+    // Gershgorin bound on the Jacobi spectral radius, taken on the symmetrized operator so it stays close to the true
+    // radius for the strongly non-symmetric rows near S_max
+    double rho = 0.;
+    for(int i = 1; i < N; i++){
+        double left = sqrt(abs(M1.lower(i) * M1.upper(i - 1) / (M1.diag(i) * M1.diag(i - 1))));
+        double right = sqrt(abs(M1.upper(i) * M1.lower(i + 1) / (M1.diag(i) * M1.diag(i + 1))));
+        rho = max(rho, left + right);
+    }
+    rho = min(rho, sorMaxSpectralRadius);
+    return 2. / (1. + sqrt(1. - rho * rho));
+}
+
+void adaptSORWeight(double& weight, double& step, const int iterations, int& lastIterations){
+    // Nothing to learn from steps that converge straight away
+    if(iterations > 2 && lastIterations > 0){
+        // Keep moving while the sweep count falls, reverse with a smaller step when it rises
+        if(iterations > lastIterations) step = -step / 2.;
+        if(iterations != lastIterations) weight = min(max(weight + step, 1.), sorMaxWeight);
+    }
+    lastIterations = iterations;
+}
+
+void recordIterations(SolverStats& stats, const int iterations, const double weight, const double residual,
+                      const bool converged){
+    stats.steps++;
+    stats.totalIterations += iterations;
+    stats.maxIterations = max(stats.maxIterations, iterations);
+    if(!converged) stats.nonConverged++;
+    stats.weight = weight;
+    stats.finalResidual = residual;
+    stats.maxResidual = max(stats.maxResidual, residual);
+    stats.stepIterations.push_back(iterations);
+}
+
+void resetStats(SolverStats& stats){
+    stats.steps = 0;
+    stats.totalIterations = 0;
+    stats.maxIterations = 0;
+    stats.nonConverged = 0;
+    stats.weight = 0.;
+    stats.finalResidual = 0.;
+    stats.maxResidual = 0.;
+    fill(begin(stats.phaseSeconds), end(stats.phaseSeconds), 0.);
+    stats.stepIterations.clear();
+}
+
+template<bool Call>
+static int warmStart(Ref<VectorXd, 0, InnerStride<>> v, const Ref<const VectorXd, 0, InnerStride<>>& w,
+                     const Ref<const VectorXd, 0, InnerStride<>>& wOld, const Ref<const VectorXd>& obstacle,
+                     const int N, ExerciseBoundary& boundary){
+    // Node j counted from the exercise end
+    auto node = [&](int j){ return Call ? N - j : j; };
+    // The first slice is the payoff itself, nothing to measure yet
+    if(boundary.slices++ == 0) return 0;
+    int depth = 0;
+    while(depth <= N && w(node(depth)) <= obstacle(node(depth))) depth++;
+    boundary.previous = boundary.last;
+    boundary.last = depth;
+    if(boundary.slices == 2) return max(0, min(depth, N - 1) - exerciseHoldMargin);
+    // Two solved slices, extrapolate the values and the boundary
+    for(int i = 0; i <= N; i++) v(i) = max(2. * w(i) - wOld(i), obstacle(i));
+    int predicted = min(max(2 * boundary.last - boundary.previous, 0), N + 1);
+    for(int j = depth; j < predicted; j++) v(node(j)) = obstacle(node(j));
+    return max(0, min(min(depth, predicted), N - 1) - exerciseHoldMargin);
+}
+
+int warmStart(Ref<VectorXd, 0, InnerStride<>> v, const Ref<const VectorXd, 0, InnerStride<>>& w,
+              const Ref<const VectorXd, 0, InnerStride<>>& wOld, const Ref<const VectorXd>& obstacle, const int N,
+              const bool type, ExerciseBoundary& boundary){
+    return type ? warmStart<true>(v, w, wOld, obstacle, N, boundary) : warmStart<false>(v, w, wOld, obstacle, N, boundary);
+}
+
+/**
+ * Brennan-Schwartz solve of the time step: Thomas algorithm with the projection applied during back substitution.
+ * Elimination runs towards the exercise end of the grid, S_max for a call and 0 for a put, so back substitution starts
+ * inside the exercise region and crosses the (monotone) exercise boundary once: downward for a call, upward for a put.
+ */
+template<bool Call>
+static void computeBrennanSchwartz(Ref<VectorXd> v, const TridiagonalMatrix& M1, const Ref<const VectorXd>& d,
+                                   const Ref<const VectorXd>& obstacle, Ref<VectorXd> elimCoef,
+                                   Ref<VectorXd> elimRhs, const int N){
+    if(Call){
+        // Eliminate the lower diagonal moving up the grid, then substitute down from S_max
+        elimCoef(0) = M1.upper(0) / M1.diag(0);
+        elimRhs(0) = d(0) / M1.diag(0);
+        for(int i = 1; i <= N; i++){
+            double m = M1.diag(i) - M1.lower(i) * elimCoef(i - 1);
+            elimCoef(i) = M1.upper(i) / m;
+            elimRhs(i) = (d(i) - M1.lower(i) * elimRhs(i - 1)) / m;
+        }
+        v(N) = max(elimRhs(N), obstacle(N));
+        for(int i = N - 1; i >= 0; i--){
+            v(i) = max(elimRhs(i) - elimCoef(i) * v(i + 1), obstacle(i));
+        }
+    }
+    else{
+        // Eliminate the upper diagonal moving down the grid, then substitute up from S_min
+        elimCoef(N) = M1.lower(N) / M1.diag(N);
+        elimRhs(N) = d(N) / M1.diag(N);
+        for(int i = N - 1; i >= 0; i--){
+            double m = M1.diag(i) - M1.upper(i) * elimCoef(i + 1);
+            elimCoef(i) = M1.lower(i) / m;
+            elimRhs(i) = (d(i) - M1.upper(i) * elimRhs(i + 1)) / m;
+        }
+        v(0) = max(elimRhs(0), obstacle(0));
+        for(int i = 1; i <= N; i++){
+            v(i) = max(elimRhs(i) - elimCoef(i) * v(i - 1), obstacle(i));
+        }
+    }
+}
+
+/**
+ * Grid interval [S_i(j), S_i(j + 1)] holding S, clamped to [first, last]
+ */
+static int gridInterval(const Ref<const VectorXd>& S_i, const double S, const int first, const int last){
+    int j = int(upper_bound(S_i.data(), S_i.data() + S_i.size(), S) - S_i.data()) - 1;
+    return min(max(j, first), last);
+}
+
+/**
+ * Cubic through nodes j - 1 to j + 2 evaluated at S, value(i) gives the value at node i
+ */
+template<class Values>
+static double cubicAt(const Ref<const VectorXd>& S_i, const int j, const double S, const Values& value){
+    double result = 0.;
+    for(int a = j - 1; a <= j + 2; a++){
+        double basis = 1.;
+        for(int b = j - 1; b <= j + 2; b++){
+            if(b != a) basis *= (S - S_i(b)) / (S_i(a) - S_i(b));
+        }
+        result += basis * value(a);
+    }
+    return result;
 }
 
-double interpPrice(const VectorXd v, const VectorXd S_i, const double S, const double dS){
-    int jStar = S / dS;
+double interpPrice(const Ref<const VectorXd>& v, const Ref<const VectorXd>& S_i, const double S,
+                   const GridInterpolation interpolation){
+    // Clamp to the last grid interval so prices beyond S_max are extrapolated rather than read out of bounds
+    int jStar = gridInterval(S_i, S, 0, int(v.size()) - 2);
+    if(interpolation == GridInterpolation::Cubic && jStar >= 1 && jStar <= int(v.size()) - 3){
+        return cubicAt(S_i, jStar, S, [&v](int i){ return v(i); });
+    }
+    double h = S_i(jStar + 1) - S_i(jStar);
     double price = 0.;
-    price += (S - S_i(jStar)) / dS * v(jStar + 1);
-    price += (S_i(jStar + 1) - S) / dS * v(jStar);
+    price += (S - S_i(jStar)) / h * v(jStar + 1);
+    price += (S_i(jStar + 1) - S) / h * v(jStar);
     return price;
 }
 
-double priceAmericanPSOR(const double S, const double T, const double sig, const double K, const double r, const bool type) {
-    // Grid variables
-    double S_min = 0.0;
-    double S_max = 2. * K;
-    int M = 100; // time steps
-    int N = 100; // max nodes
-    // Algorithm variables
-    double theta = .5;
-    double weight = 1.;
-    int maxIter = 200;
-    double err = pow(10, -4);
-    double dt = T / M;
-    double dS = S_max / double(N);
+/**
+ * Three point first and second derivatives at inner node j, exact for quadratics on uneven spacing
+ */
+static void nodeDerivatives(const Ref<const VectorXd>& v, const Ref<const VectorXd>& S_i, const int j,
+                            double& delta, double& gamma){
+    double hDown = S_i(j) - S_i(j - 1);
+    double hUp = S_i(j + 1) - S_i(j);
+    delta = (-hUp / (hDown * (hDown + hUp))) * v(j - 1) + (hUp - hDown) / (hDown * hUp) * v(j)
+            + hDown / (hUp * (hDown + hUp)) * v(j + 1);
+    gamma = 2. * (v(j - 1) / (hDown * (hDown + hUp)) - v(j) / (hDown * hUp) + v(j + 1) / (hUp * (hDown + hUp)));
+}
+
+/**
+ * Reads price, delta, gamma and theta off the grid at S. Delta and gamma are central differences at the nodes around
+ * S, interpolated as the price; theta is the change from the previous time slice.
+ */
+PricingResult interpGreeks(const Ref<const VectorXd>& v, const Ref<const VectorXd>& vPrev, const Ref<const VectorXd>& S_i,
+                           const double S, const double dt, const GridInterpolation interpolation){
+    PricingResult result;
+    result.price = interpPrice(v, S_i, S, interpolation);
+    result.theta = (interpPrice(vPrev, S_i, S, interpolation) - result.price) / dt;
+    // Cubic needs central differences at two nodes either side of S
+    int jCubic = gridInterval(S_i, S, 0, int(v.size()) - 2);
+    if(interpolation == GridInterpolation::Cubic && jCubic >= 2 && jCubic <= int(v.size()) - 4){
+        double delta[4], gamma[4];
+        for(int a = 0; a < 4; a++) nodeDerivatives(v, S_i, jCubic - 1 + a, delta[a], gamma[a]);
+        result.delta = cubicAt(S_i, jCubic, S, [&](int i){ return delta[i - jCubic + 1]; });
+        result.gamma = cubicAt(S_i, jCubic, S, [&](int i){ return gamma[i - jCubic + 1]; });
+        return result;
+    }
+    // Keep one node either side of the interval for the central differences
+    int jStar = gridInterval(S_i, S, 1, int(v.size()) - 3);
+    double weight = (S - S_i(jStar)) / (S_i(jStar + 1) - S_i(jStar));
+    double deltaLo, gammaLo, deltaHi, gammaHi;
+    nodeDerivatives(v, S_i, jStar, deltaLo, gammaLo);
+    nodeDerivatives(v, S_i, jStar + 1, deltaHi, gammaHi);
+    result.delta = (1. - weight) * deltaLo + weight * deltaHi;
+    result.gamma = (1. - weight) * gammaLo + weight * gammaHi;
+    return result;
+}
+
+/**
+ * Fills S_i with the nodes of a grid over [0, config.spaceMax], in units of strike
+ */
+static void initNodes(Ref<VectorXd> S_i, const int N, const PricingConfig& config, const double spot){
+    double S_max = config.spaceMax;
+    if(config.spacing == GridSpacing::Uniform){
+        double dS = S_max / double(N);
+        for(int i = 0; i <= N; i++) S_i(i) = i * dS;
+        return;
+    }
+    // S(x) = K + alpha sinh(c1 + x (c2 - c1)) maps [0, 1] onto [0, S_max], with nodes densest around K = 1
+    double alpha = config.concentration;
+    double c1 = asinh(-1. / alpha);
+    double c2 = asinh((S_max - 1.) / alpha);
+    // Uniform x, or piecewise uniform either side of the x of the spot so a node lands on it
+    double xSpot = 0.;
+    int jSpot = 0;
+    if(spot > 0. && spot < S_max){
+        xSpot = (asinh((spot - 1.) / alpha) - c1) / (c2 - c1);
+        jSpot = min(max(int(lround(xSpot * N)), 1), N - 1);
+    }
+    for(int i = 0; i <= N; i++){
+        double x = double(i) / N;
+        if(jSpot > 0){
+            x = i <= jSpot ? xSpot * i / jSpot : xSpot + (1. - xSpot) * (i - jSpot) / (N - jSpot);
+        }
+        S_i(i) = 1. + alpha * sinh(c1 + x * (c2 - c1));
+    }
+    S_i(0) = 0.;
+    S_i(N) = S_max;
+    if(jSpot > 0) S_i(jSpot) = spot;
+}
+
+PricingConfig coveringConfig(const PricingConfig& config, const double moneyness) {
+    PricingConfig covering = config;
+    double needed = gridSpaceMargin * moneyness;
+    if(needed > config.spaceMax){
+        covering.spaceMax = ceil(needed / gridSpaceStep) * gridSpaceStep;
+        covering.spacing = GridSpacing::Sinh;
+    }
+    return covering;
+}
+
+void gridBoundary(const bool type, const double S_max, const double discount, double& low, double& high) {
+    low = type ? 0. : discount;
+    high = type ? S_max - discount : 0.;
+}
+
+double priceFloor(const bool type, const double S, const double K, const double discount) {
+    return type ? max(S - K * discount, 0.) : payoff(S, K, type);
+}
+
+double gridReach(const PSORWorkspace& ws) {
+    // interpGreeks takes central differences at the nodes either side of S, the last usable interval ends at N - 2
+    return ws.S_i(ws.S_i.size() - 3);
+}
+
+void setupNormalizedGrid(PSORWorkspace& ws, const double T, const double sig, const double r, const bool type,
+                         const PricingConfig& config, const double spot) {
+    int N = int(ws.S_i.size()) - 1; // max nodes
+    assert(N == config.nodes && "workspace and config disagree on the node count");
+    TraceSpan span("setupNormalizedGrid", "solve", type ? "call" : "put");
+    resetStats(ws.stats);
+    PhaseTimer timer(ws.stats, SetupPhase);
+    double dt = T / config.timeSteps;
+    ws.dt = dt;
+    ws.r = r;
+    ws.discount = exp(-r * T);
+    // Grid, in units of strike
+    initNodes(ws.S_i, N, config, spot);
     // Initialize finite difference method parameters
-    MatrixXd M1 = MatrixXd::Zero(N + 1, N + 1);
-    initMatrix(M1, N, theta, .2, r, dt);
-    // Set initial conditions
-        VectorXd S_i(N + 1);
-        VectorXd w(N + 1);
-        VectorXd v(N + 1);
+    ws.nodeVol.setConstant(sig);
+    initOperator(ws.L, ws.S_i, ws.nodeVol, N, r);
+    setOperatorTheta(ws, config.smoothingSteps > 0 ? 1. : config.theta);
+    // Exercise values the solvers project onto, and initial conditions
     for(int i = 0; i <= N; i++){
-        S_i(i) = i * dS;
-        w(i) = payoff(S_i(i), K, type);
-        v(i) = payoff(S_i(i), K, type);
+        ws.obstacle(i) = type ? exerciseValue<true>(ws.S_i(i), 1.) : exerciseValue<false>(ws.S_i(i), 1.);
+        ws.w(i) = max(ws.obstacle(i), 0.);
+        ws.v(i) = ws.w(i);
     }
+    // Room for per step counts before the time loop, which must not allocate
+    ws.stats.stepIterations.reserve(config.timeSteps);
+}
+
+void setLocalVolatility(PSORWorkspace& ws, const VolSurface& surface, const double K, const double T, const double r,
+                        const PricingConfig& config) {
+    PhaseTimer timer(ws.stats, SetupPhase);
+    int N = int(ws.S_i.size()) - 1;
+    for(int i = 0; i <= N; i++) ws.nodeVol(i) = surface.vol(ws.S_i(i) * K, T);
+    initOperator(ws.L, ws.S_i, ws.nodeVol, N, r);
+    setOperatorTheta(ws, config.smoothingSteps > 0 ? 1. : config.theta);
+}
+
+void setOperatorTheta(PSORWorkspace& ws, const double theta) {
+    initMatrix(ws.M1, ws.M2, ws.invDiag, ws.L, int(ws.S_i.size()) - 1, theta, ws.dt);
+}
+
+/**
+ * Time stepping of solveNormalizedGrid on a grid set up by setupNormalizedGrid, compiled once per option type
+ */
+template<bool Call>
+static void stepNormalizedGrid(PSORWorkspace& ws, const double r, const double K_max,
+                               const PSORSolver solver, ThreadPool* pool, const PricingConfig& config) {
+    int M = config.timeSteps;
+    int N = int(ws.S_i.size()) - 1;
+    double dt = ws.dt;
+    // Tolerance is on squared price changes, so scale it down to the largest strike read off the grid
+    double err = config.tolerance / (K_max * K_max);
+    // Relaxation factor, estimated from the operator then tuned between time steps
+    double weight = config.weight > 0. ? config.weight : estimateSORWeight(ws.M1, N);
+    double weightStep = sorWeightStep;
+    int lastIterations = 0;
+    ExerciseBoundary boundary;
+    // Rannacher steps are fully implicit, M2 is then diagonal
+    bool implicit = config.smoothingSteps > 0 || config.theta == 1.;
+#if defined(PSOR_ALLOCATION_COUNTER_ENABLED) && !defined(NDEBUG)
+    const size_t allocationsBefore = threadAllocationCount();
+#endif
     // Compute difference method through time
     for(int t = M - 1; t >= 0; t--){
+        // Smoothing steps done, switch to the configured scheme
+        if(config.smoothingSteps > 0 && t == M - 1 - config.smoothingSteps){
+            PhaseTimer timer(ws.stats, SetupPhase);
+            setOperatorTheta(ws, config.theta);
+            implicit = config.theta == 1.;
+        }
+        // Keep the slice one step before today for theta
+        if(t == 0) ws.vPrev = ws.v;
         // Compute previous time step
-        VectorXd d(N + 1);
-        initPrev(d, w, M1, K, N, M, t, dt, r);
-        // SOR
-        computeSOR(v, M1, d, S_i, maxIter, N, weight, K, err, type);
+        {
+            PhaseTimer timer(ws.stats, RhsPhase);
+            double low, high;
+            gridBoundary(Call, ws.S_i(N), exp(-r * (M - t) * dt), low, high);
+            if(implicit) initPrev<true>(ws.d, ws.w, ws.M2, N, low, high);
+            else initPrev<false>(ws.d, ws.w, ws.M2, N, low, high);
+        }
+        // Solve the linear complementarity problem, direct solvers are exact
+        int iterations = 1;
+        double residual = 0.;
+        {
+            PhaseTimer timer(ws.stats, SolvePhase);
+            if(solver == PSORSolver::BrennanSchwartz){
+                computeBrennanSchwartz<Call>(ws.v, ws.M1, ws.d, ws.obstacle, ws.elimCoef, ws.elimRhs, N);
+            }
+            else if(solver == PSORSolver::RedBlackPSOR){
+                warmStart<Call>(ws.v, ws.w, ws.wOld, ws.obstacle, N, boundary);
+                iterations = computeRedBlackSOR(ws.v, ws.M1, ws.invDiag, ws.d, ws.obstacle, ws.elimRhs,
+                                                ws.chunkError, config.maxIter, N, weight, err, pool, residual);
+            }
+            else{
+                int held = warmStart<Call>(ws.v, ws.w, ws.wOld, ws.obstacle, N, boundary);
+                iterations = computeSOR<Call>(ws.v, ws.M1, ws.invDiag, ws.d, ws.obstacle, config.maxIter, N, weight,
+                                              err, held, residual);
+            }
+        }
+        // This slice is the previous one for the next step
+        ws.wOld = ws.w;
+        ws.w = ws.v;
+        recordIterations(ws.stats, iterations, weight, residual * K_max * K_max, residual < err);
+        if(config.weight <= 0.) adaptSORWeight(weight, weightStep, iterations, lastIterations);
     }
-    // Interpolate option price
-    double price = interpPrice(v, S_i, S, dS);
-    return price;
-}
\ No newline at end of file
+#if defined(PSOR_ALLOCATION_COUNTER_ENABLED) && !defined(NDEBUG)
+    // Handing chunks to a thread pool allocates, the single threaded solvers must not
+    assert((pool || threadAllocationCount() == allocationsBefore) && "PSOR time stepping must not allocate");
+#endif
+}
+
+void solveNormalizedGrid(PSORWorkspace& ws, const double T, const double sig, const double r, const bool type,
+                         const double K_max, const PSORSolver solver, ThreadPool* pool, const PricingConfig& config,
+                         const double spot) {
+    setupNormalizedGrid(ws, T, sig, r, type, config, spot);
+    timeStepNormalizedGrid(ws, r, type, K_max, solver, pool, config);
+}
+
+void timeStepNormalizedGrid(PSORWorkspace& ws, const double r, const bool type, const double K_max,
+                            const PSORSolver solver, ThreadPool* pool, const PricingConfig& config) {
+    TraceSpan span("timeStepNormalizedGrid", "solve", type ? "call" : "put");
+    // Branch on the option type once per solve, not per node
+    if(type) stepNormalizedGrid<true>(ws, r, K_max, solver, pool, config);
+    else stepNormalizedGrid<false>(ws, r, K_max, solver, pool, config);
+}
+
+PricingResult readNormalizedGrid(const PSORWorkspace& ws, const double S, const double K, const bool type,
+                                 const GridInterpolation interpolation) {
+    PricingResult greeks = interpGreeks(ws.v, ws.vPrev, ws.S_i, S / K, ws.dt, interpolation);
+    // Scale back to the strike, never below the lower bound, which is all there is past the end of the grid
+    double floor = priceFloor(type, S, K, ws.discount);
+    PricingResult result;
+    // Interpolating between exercised nodes lands on the bound up to rounding
+    if(S / K > gridReach(ws) || K * greeks.price <= floor + 1e-12 * K){
+        // On the bound: linear in S, and for a call accreting the discounted strike
+        bool inTheMoney = floor > 0.;
+        result.price = floor;
+        result.delta = inTheMoney ? (type ? 1. : -1.) : 0.;
+        result.gamma = 0.;
+        result.theta = inTheMoney && type ? -ws.r * K * ws.discount : 0.;
+        return result;
+    }
+    result.price = K * greeks.price;
+    result.delta = greeks.delta;
+    result.gamma = greeks.gamma / K;
+    result.theta = K * greeks.theta;
+    return result;
+}
+
+/**
+ * Prices every strike of a chain sharing expiry, volatility, rate and type from a single PDE solve
+ * @param results output, resized to match strikes
+ */
+void priceAmericanChainPSOR(const double S, const double T, const double sig, const vector<double>& strikes, const double r,
+                            const bool type, vector<PricingResult>& results, const PSORSolver solver, ThreadPool* pool,
+                            SolverStats* stats, const PricingConfig& config) {
+    results.resize(strikes.size());
+    if(strikes.empty()) return;
+    PSORWorkspace ws(config.nodes);
+    // A single strike has a single normalized spot for a sinh grid to put a node on
+    double spot = strikes.size() == 1 ? S / strikes[0] : 0.;
+    // Room on the grid for the deepest in the money call
+    PricingConfig covering = coveringConfig(config, S / *min_element(strikes.begin(), strikes.end()));
+    solveNormalizedGrid(ws, T, sig, r, type, *max_element(strikes.begin(), strikes.end()), solver, pool, covering, spot);
+    {
+        PhaseTimer timer(ws.stats, ReadPhase);
+        for(size_t k = 0; k < strikes.size(); k++){
+            results[k] = readNormalizedGrid(ws, S, strikes[k], type, config.interpolation);
+        }
+    }
+    if(stats) *stats = ws.stats;
+}
+
+void priceAmericanChainPSOR(const double S, const double T, const double sig, const vector<double>& strikes, const double r,
+                            const bool type, vector<double>& prices, const PSORSolver solver) {
+    vector<PricingResult> results;
+    priceAmericanChainPSOR(S, T, sig, strikes, r, type, results, solver);
+    prices.resize(results.size());
+    for(size_t k = 0; k < results.size(); k++) prices[k] = results[k].price;
+}
+
+double priceAmericanPSOR(const double S, const double T, const double sig, const double K, const double r, const bool type,
+                         const PSORSolver solver, ThreadPool* pool, const PricingConfig& config) {
+    return priceAmericanPSORGreeks(S, T, sig, K, r, type, solver, pool, nullptr, config).price;
+}
+
+PricingResult priceAmericanPSORGreeks(const double S, const double T, const double sig, const double K, const double r,
+                                      const bool type, const PSORSolver solver, ThreadPool* pool, SolverStats* stats,
+                                      const PricingConfig& config) {
+    vector<PricingResult> results;
+    priceAmericanChainPSOR(S, T, sig, {K}, r, type, results, solver, pool, stats, config);
+    return results[0];
+}
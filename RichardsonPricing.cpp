@@ -0,0 +1,61 @@
+#include "RichardsonPricing.h"
+#include <cassert>
+#include <cmath>
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Extrapolation weights by number of levels, coarsest grid first, for errors in h^2 + h^3
+static const double smoothWeights[richardsonMaxLevels + 1][richardsonMaxLevels] = {
+    {}, {1.}, {-1. / 3., 4. / 3.}, {1. / 21., -12. / 21., 32. / 21.}
+};
+// For errors in dt + dt^2
+static const double stepWeights[richardsonMaxLevels + 1][richardsonMaxLevels] = {
+    {}, {1.}, {-1., 2.}, {1. / 3., -2., 8. / 3.}
+};
+
+void priceAmericanChainRichardson(const double S, const double T, const double sig, const vector<double>& strikes,
+                                  const double r, const bool type, vector<PricingResult>& results, const int levels,
+                                  const PSORSolver solver, ThreadPool* pool, const PricingConfig& config) {
+    assert(levels >= 1 && levels <= richardsonMaxLevels && "Richardson extrapolation takes 1 to 3 grids");
+    results.assign(strikes.size(), PricingResult{0., 0., 0., 0.});
+    if(strikes.empty()) return;
+    // One chain per grid, level l has 2^l times the nodes and time steps of config
+    vector<vector<PricingResult>> levelResults(levels);
+    auto solveLevel = [&](size_t l){
+        PricingConfig levelConfig = config;
+        levelConfig.nodes = config.nodes << l;
+        levelConfig.timeSteps = config.timeSteps << l;
+        // Linear read-off error depends on where S / K falls between nodes, which changes irregularly with refinement
+        levelConfig.interpolation = GridInterpolation::Cubic;
+        priceAmericanChainPSOR(S, T, sig, strikes, r, type, levelResults[l], solver, pool, nullptr, levelConfig);
+    };
+    // Finest grid first, it takes the longest
+    auto finestFirst = [&](size_t i){ solveLevel(size_t(levels) - 1 - i); };
+    if(pool) pool->parallelFor(size_t(levels), finestFirst);
+    else for(int i = 0; i < levels; i++) finestFirst(size_t(i));
+    for(int l = 0; l < levels; l++){
+        double smooth = smoothWeights[levels][l];
+        double step = stepWeights[levels][l];
+        for(size_t k = 0; k < strikes.size(); k++){
+            const PricingResult& level = levelResults[l][k];
+            results[k].price += smooth * level.price;
+            results[k].delta += smooth * level.delta;
+            results[k].gamma += smooth * level.gamma;
+            results[k].theta += step * level.theta;
+        }
+    }
+    // Never below the price floor, as a single grid read
+    double discount = exp(-r * T);
+    for(size_t k = 0; k < strikes.size(); k++){
+        results[k].price = max(results[k].price, priceFloor(type, S, strikes[k], discount));
+    }
+}
+
+PricingResult priceAmericanRichardson(const double S, const double T, const double sig, const double K, const double r,
+                                      const bool type, const int levels, const PSORSolver solver, ThreadPool* pool,
+                                      const PricingConfig& config) {
+    vector<PricingResult> results;
+    priceAmericanChainRichardson(S, T, sig, {K}, r, type, results, levels, solver, pool, config);
+    return results[0];
+}
@@ -0,0 +1,29 @@
+#ifndef AMERICANOPTIONSPRICING_RICHARDSONPRICING_H
+#define AMERICANOPTIONSPRICING_RICHARDSONPRICING_H
+
+#include <vector>
+#include "Price_American_PSOR.h"
+
+const int richardsonLevels = 2;     // grids combined by default
+const int richardsonMaxLevels = 3;
+
+/**
+ * Prices every strike of a chain on two or three grids, each with twice the nodes and time steps of the one before,
+ * starting from config, and Richardson-extrapolates price and greeks. Price, delta and gamma assume errors in
+ * h^2 + h^3 and theta, a one step difference, errors in dt + dt^2. The grids are solved concurrently on pool when one
+ * is given. config.tolerance should sit well below the accuracy wanted, extrapolation amplifies PSOR noise about 2x.
+ * @param levels number of grids, 2 or 3
+ * @param results output, resized to match strikes
+ */
+void priceAmericanChainRichardson(const double S, const double T, const double sig, const std::vector<double>& strikes,
+                                  const double r, const bool type, std::vector<PricingResult>& results,
+                                  const int levels = richardsonLevels, const PSORSolver solver = PSORSolver::PSOR,
+                                  ThreadPool* pool = nullptr, const PricingConfig& config = PricingConfig());
+
+// Single contract version of priceAmericanChainRichardson
+PricingResult priceAmericanRichardson(const double S, const double T, const double sig, const double K, const double r,
+                                      const bool type, const int levels = richardsonLevels,
+                                      const PSORSolver solver = PSORSolver::PSOR, ThreadPool* pool = nullptr,
+                                      const PricingConfig& config = PricingConfig());
+
+#endif //AMERICANOPTIONSPRICING_RICHARDSONPRICING_H
@@ -0,0 +1,106 @@
+#ifndef AMERICANOPTIONSPRICING_SPMCQUEUE_H
+#define AMERICANOPTIONSPRICING_SPMCQUEUE_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <thread>
+
+/**
+ * Bounded lock-free queue with a single producer and any number of consumers. Each slot carries a sequence number
+ * telling whose turn it is: slot i of lap n is free for the producer when it reads i + n * capacity and holds a value
+ * for the consumers when it reads that plus one. Consumers claim values by advancing tail with a compare-exchange, the
+ * producer owns head outright. A consumer hands its slot back only after copying the value out, so a slot can stay taken
+ * for a moment after tail has moved past it.
+ */
+template<class T>
+class SPMCQueue {
+public:
+    // Constructor, capacity is rounded up to a power of two
+    explicit SPMCQueue(std::size_t capacity)
+        : mask(roundUp(capacity) - 1), slots(new Slot[mask + 1]), head(0), tail(0){
+        for(std::size_t i = 0; i <= mask; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    SPMCQueue(const SPMCQueue&) = delete;
+    SPMCQueue& operator=(const SPMCQueue&) = delete;
+
+    // Getters
+    std::size_t capacity() const {
+        return mask + 1;
+    }
+    bool empty() const {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+
+    /**
+     * Appends value, producer thread only
+     * @return false when the queue is full, or its next slot was claimed by a consumer that has not handed it back yet
+     */
+    bool push(const T& value) {
+        std::size_t pos = head.load(std::memory_order_relaxed);
+        Slot& slot = slots[pos & mask];
+        if(slot.sequence.load(std::memory_order_acquire) != pos) return false;
+        slot.value = value;
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Appends value, waiting for its slot when a consumer has claimed the value a lap ago but not handed the slot back,
+     * which takes the consumer two stores. Producer thread only, and only while the queue holds fewer than capacity()
+     * unclaimed values: a full queue would wait for a pop.
+     */
+    void pushWait(const T& value) {
+        assert(head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed) < capacity()
+               && "pushWait on a full queue");
+        while(!push(value)) std::this_thread::yield();
+    }
+
+    /**
+     * Takes the oldest value, from any thread
+     * @return false when the queue is empty
+     */
+    bool pop(T& value) {
+        std::size_t pos = tail.load(std::memory_order_relaxed);
+        while(true){
+            Slot& slot = slots[pos & mask];
+            std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            if(sequence == pos + 1){
+                if(tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){
+                    value = slot.value;
+                    // Hand the slot back to the producer for its next lap
+                    slot.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+                // pos now holds the tail another consumer moved to
+            }
+            else if(sequence == pos){
+                return false;
+            }
+            else{
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static std::size_t roundUp(std::size_t n) {
+        std::size_t size = 1;
+        while(size < n) size <<= 1;
+        return size;
+    }
+
+    const std::size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<std::size_t> head;      // Next slot the producer fills
+    alignas(64) std::atomic<std::size_t> tail;      // Next slot a consumer takes
+};
+
+#endif //AMERICANOPTIONSPRICING_SPMCQUEUE_H
@@ -0,0 +1,131 @@
+#include "SolverProfile.h"
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
+using namespace std;
+
+LogHistogram::LogHistogram(double base, int minExponent, int buckets)
+    : base(base), minExponent(minExponent), counts(size_t(buckets), 0){
+}
+
+void LogHistogram::add(double value) {
+    int bucket = 0;
+    if(value > 0.) bucket = int(floor(log(value) / log(base))) - minExponent;
+    counts[size_t(min(max(bucket, 0), int(counts.size()) - 1))]++;
+}
+
+void LogHistogram::merge(const LogHistogram& other) {
+    for(size_t b = 0; b < counts.size(); b++) counts[b] += other.counts[b];
+}
+
+void LogHistogram::clear() {
+    fill(counts.begin(), counts.end(), 0);
+}
+
+void LogHistogram::print(ostream& out, const string& title, const string& unit) const {
+    out << title << "\n";
+    size_t total = 0;
+    for(size_t count: counts) total += count;
+    for(size_t b = 0; b < counts.size(); b++){
+        if(counts[b] == 0) continue;
+        // The first bucket also holds everything below it, so it is labelled by its upper edge
+        double edge = pow(base, minExponent + int(b) + (b == 0 ? 1 : 0));
+        out << "  " << (b == 0 ? "< " : ">=") << setw(10) << edge << " " << unit << setw(10) << counts[b] << " "
+            << fixed << setprecision(1) << setw(5) << 100. * double(counts[b]) / double(total) << "%"
+            << defaultfloat << setprecision(6) << "\n";
+    }
+}
+
+SolverProfile::SolverProfile(size_t worstKept)
+    : worstKept(worstKept), solves(0), steps(0), sweeps(0), nonConvergedSteps(0), nonConvergedSolves(0),
+      phaseSeconds(), stepSweeps(2., 0, 12), solveResidual(10., -12, 14), solveMicros(2., 0, 24){
+}
+
+void SolverProfile::add(const SolverStats& stats, const LockstepGrid& grid, double tolerance) {
+    solves++;
+    steps += size_t(stats.steps);
+    sweeps += size_t(stats.totalIterations);
+    nonConvergedSteps += size_t(stats.nonConverged);
+    if(stats.nonConverged > 0) nonConvergedSolves++;
+    double seconds = 0.;
+    for(int phase = 0; phase < SolverPhases; phase++){
+        phaseSeconds[phase] += stats.phaseSeconds[phase];
+        seconds += stats.phaseSeconds[phase];
+    }
+    for(int iterations: stats.stepIterations) stepSweeps.add(double(iterations));
+    solveResidual.add(stats.maxResidual / tolerance);
+    if(seconds > 0.) solveMicros.add(1e6 * seconds);
+    keepWorst(CostlySolve{grid, seconds > 0. ? seconds : double(stats.totalIterations), seconds,
+                          stats.totalIterations, stats.nonConverged});
+}
+
+void SolverProfile::merge(const SolverProfile& other) {
+    solves += other.solves;
+    steps += other.steps;
+    sweeps += other.sweeps;
+    nonConvergedSteps += other.nonConvergedSteps;
+    nonConvergedSolves += other.nonConvergedSolves;
+    for(int phase = 0; phase < SolverPhases; phase++) phaseSeconds[phase] += other.phaseSeconds[phase];
+    stepSweeps.merge(other.stepSweeps);
+    solveResidual.merge(other.solveResidual);
+    solveMicros.merge(other.solveMicros);
+    for(const auto& solve: other.worst) keepWorst(solve);
+}
+
+void SolverProfile::clear() {
+    solves = steps = sweeps = nonConvergedSteps = nonConvergedSolves = 0;
+    fill(begin(phaseSeconds), end(phaseSeconds), 0.);
+    stepSweeps.clear();
+    solveResidual.clear();
+    solveMicros.clear();
+    worst.clear();
+}
+
+void SolverProfile::keepWorst(const CostlySolve& solve) {
+    if(worstKept == 0) return;
+    if(worst.size() == worstKept && solve.cost <= worst.back().cost) return;
+    auto at = upper_bound(worst.begin(), worst.end(), solve, [](const CostlySolve& a, const CostlySolve& b){
+        return a.cost > b.cost;
+    });
+    worst.insert(at, solve);
+    if(worst.size() > worstKept) worst.pop_back();
+}
+
+void SolverProfile::dump(ostream& out) const {
+    out << "Solves " << solves << ", time steps " << steps << ", sweeps " << sweeps << ", non-converged steps "
+        << nonConvergedSteps << " in " << nonConvergedSolves << " solves\n";
+    double total = 0.;
+    for(double seconds: phaseSeconds) total += seconds;
+    if(total > 0.){
+        const char* names[SolverPhases] = {"setup", "rhs", "solve", "read"};
+        out << "Phase time";
+        for(int phase = 0; phase < SolverPhases; phase++){
+            out << " " << names[phase] << " " << 1e6 * phaseSeconds[phase] << " us";
+        }
+        out << "\n";
+    }
+    else{
+        out << "Phase time not measured, build with PSOR_SOLVER_STATS\n";
+    }
+    stepSweeps.print(out, "Sweeps per time step", "sweeps");
+    solveResidual.print(out, "Largest final residual per solve, over tolerance", "");
+    if(total > 0.) solveMicros.print(out, "Time per solve", "us");
+    out << "Costliest solves\n";
+    for(const auto& solve: worst){
+        out << "  T " << solve.grid.T << " vol " << solve.grid.sig << " r " << solve.grid.r << " "
+            << (solve.grid.type ? "call" : "put") << " K_max " << solve.grid.K_max
+            << (solve.grid.localVol ? " local vol" : "") << ": " << solve.sweeps << " sweeps, " << solve.nonConverged
+            << " non-converged steps";
+        if(solve.seconds > 0.) out << ", " << 1e6 * solve.seconds << " us";
+        out << "\n";
+    }
+}
+
+size_t SolverProfile::getSolves() const {
+    return solves;
+}
+
+size_t SolverProfile::getNonConvergedSteps() const {
+    return nonConvergedSteps;
+}
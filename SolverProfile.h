@@ -0,0 +1,80 @@
+#ifndef AMERICANOPTIONSPRICING_SOLVERPROFILE_H
+#define AMERICANOPTIONSPRICING_SOLVERPROFILE_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "LockstepPSOR.h"
+
+/**
+ * Counts of values in logarithmic buckets, bucket b holds values in [base^(minExponent + b), base^(minExponent + b + 1)).
+ * Values below the first bucket are counted in it, values above the last in the last.
+ */
+class LogHistogram {
+public:
+    // Constructor
+    LogHistogram(double base, int minExponent, int buckets);
+
+    void add(double value);
+    void merge(const LogHistogram& other);
+    void clear();
+    // One line per non-empty bucket, with its lower edge in unit
+    void print(std::ostream& out, const std::string& title, const std::string& unit) const;
+
+private:
+    double base;
+    int minExponent;
+    std::vector<std::size_t> counts;
+};
+
+/**
+ * Aggregated solver statistics of a batch of solves: sweep, residual and solve time histograms, phase totals and the
+ * costliest grids, to find the contracts that eat the latency budget. Solve times and phase totals are only measured
+ * in builds defining PSOR_SOLVER_STATS. Not thread safe, give each thread its own profile and merge them.
+ */
+class SolverProfile {
+public:
+    // Constructor, keeps the worstKept costliest solves
+    explicit SolverProfile(std::size_t worstKept = 5);
+
+    /**
+     * Adds one solve
+     * @param grid contract of the solve, reported with the costliest solves
+     * @param tolerance PricingConfig::tolerance of the solve, residuals are histogrammed relative to it
+     */
+    void add(const SolverStats& stats, const LockstepGrid& grid, double tolerance);
+    void merge(const SolverProfile& other);
+    void clear();
+    void dump(std::ostream& out) const;
+
+    // Getters
+    std::size_t getSolves() const;
+    std::size_t getNonConvergedSteps() const;
+
+private:
+    // A solve ranked by cost, its time when measured and its sweeps otherwise
+    struct CostlySolve {
+        LockstepGrid grid;
+        double cost;
+        double seconds;
+        int sweeps;
+        int nonConverged;
+    };
+
+    std::size_t worstKept;
+    std::size_t solves;
+    std::size_t steps;
+    std::size_t sweeps;
+    std::size_t nonConvergedSteps;
+    std::size_t nonConvergedSolves;
+    double phaseSeconds[SolverPhases];
+    LogHistogram stepSweeps;        // sweeps per time step
+    LogHistogram solveResidual;     // largest final residual of a solve over its tolerance
+    LogHistogram solveMicros;       // wall time per solve
+    std::vector<CostlySolve> worst; // costliest first
+
+    void keepWorst(const CostlySolve& solve);
+};
+
+#endif //AMERICANOPTIONSPRICING_SOLVERPROFILE_H
@@ -3,13 +3,14 @@
 //
 
 #include "Stock.h"
+#include <algorithm>
 #include <string>
 
 using namespace std;
 
 
 Stock::Stock(const string& sym, double pr, double vol)
-    : symbol(sym), price(pr), volatility(vol){
+    : symbol(sym), price(pr), volatility(vol), nextHandle(0){
     // Constructor initialization list is used to initialize const members
 }
 
@@ -27,8 +28,32 @@ double Stock::getVolatility() const {
 
 void Stock::setPrice(double pr) {
     price = pr;
+    notify();
 }
 
 void Stock::setVolatility(double vol) {
     volatility = vol;
+    notify();
+}
+
+void Stock::setQuote(double pr, double vol) {
+    price = pr;
+    volatility = vol;
+    notify();
+}
+
+size_t Stock::subscribe(const function<void(const Stock&)>& subscriber) {
+    subscribers.emplace_back(nextHandle, subscriber);
+    return nextHandle++;
+}
+
+void Stock::unsubscribe(size_t handle) {
+    subscribers.erase(remove_if(subscribers.begin(), subscribers.end(),
+                                [handle](const pair<size_t, function<void(const Stock&)>>& subscriber){
+                                    return subscriber.first == handle;
+                                }), subscribers.end());
+}
+
+void Stock::notify() const {
+    for(const auto& subscriber: subscribers) subscriber.second(*this);
 }
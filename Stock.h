@@ -4,7 +4,10 @@
 
 #ifndef AMERICANOPTIONSPRICING_STOCK_H
 #define AMERICANOPTIONSPRICING_STOCK_H
+#include <cstddef>
+#include <functional>
 #include <string>
+#include <utility>
 #include <vector>
 #include "Option.h"  // Include the Option class
 
@@ -18,14 +21,28 @@ public:
     double getPrice() const;
     double getVolatility() const;
 
-    // Setters
+    // Setters, each notifies the subscribers once
     void setPrice(double pr);
     void setVolatility(double vol);
+    void setQuote(double pr, double vol);
+
+    /**
+     * Calls subscriber with the stock after every change, on the thread making the change, until unsubscribed
+     * @return handle of the subscription for unsubscribe
+     */
+    std::size_t subscribe(const std::function<void(const Stock&)>& subscriber);
+
+    // Stops calling the subscriber of handle, not while the stock is changing
+    void unsubscribe(std::size_t handle);
 
 private:
     const std::string symbol;
     double price;
     double volatility;
+    std::vector<std::pair<std::size_t, std::function<void(const Stock&)>>> subscribers;    // by handle
+    std::size_t nextHandle;
+
+    void notify() const;
 };
 
 #endif //AMERICANOPTIONSPRICING_STOCK_H
\ No newline at end of file
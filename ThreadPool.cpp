@@ -0,0 +1,99 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+// Pool and queue owned by the current thread, if it is a pool worker
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+ThreadPool::ThreadPool(unsigned int threads)
+    : queued(0), stopping(false){
+    if(threads == 0) threads = max(1u, thread::hardware_concurrency());
+    for(unsigned int i = 0; i < threads; i++) queues.emplace_back(new WorkQueue());
+    for(unsigned int i = 0; i < threads; i++) workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for(auto& worker: workers) worker.join();
+}
+
+unsigned int ThreadPool::size() const {
+    return (unsigned int)(workers.size());
+}
+
+void ThreadPool::parallelFor(size_t count, const function<void(size_t)>& body) {
+    if(count == 0) return;
+    Loop loop;
+    loop.pending = count;
+    // Deal iterations round robin, starting with our own queue when called from a worker
+    size_t home = (currentPool == this) ? currentWorker : 0;
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        queued += count;
+    }
+    for(size_t i = 0; i < count; i++){
+        WorkQueue& queue = *queues[(home + i) % queues.size()];
+        lock_guard<mutex> lock(queue.mutex);
+        queue.tasks.push_back(Task{&body, i, &loop});
+    }
+    wake.notify_all();
+    // Help out until every iteration of this loop has finished
+    while(loop.pending.load(memory_order_acquire) > 0){
+        if(!runOne(home)) this_thread::yield();
+    }
+    if(loop.error) rethrow_exception(loop.error);
+}
+
+void ThreadPool::workerLoop(size_t id) {
+    currentPool = this;
+    currentWorker = id;
+    while(true){
+        if(runOne(id)) continue;
+        unique_lock<mutex> lock(sleepMutex);
+        wake.wait(lock, [this]{ return stopping || queued > 0; });
+        if(stopping && queued == 0) return;
+    }
+}
+
+bool ThreadPool::runOne(size_t home) {
+    Task task;
+    bool found = popBack(home, task);
+    for(size_t i = 1; !found && i < queues.size(); i++){
+        found = stealFront((home + i) % queues.size(), task);
+    }
+    if(!found) return false;
+    queued--;
+    // Thrown on a worker it would terminate the program, hand it to the caller instead
+    try{
+        (*task.body)(task.index);
+    }
+    catch(...){
+        lock_guard<mutex> lock(task.loop->errorMutex);
+        if(!task.loop->error) task.loop->error = current_exception();
+    }
+    task.loop->pending.fetch_sub(1, memory_order_release);
+    return true;
+}
+
+bool ThreadPool::popBack(size_t queue, Task& task) {
+    WorkQueue& q = *queues[queue];
+    lock_guard<mutex> lock(q.mutex);
+    if(q.tasks.empty()) return false;
+    task = q.tasks.back();
+    q.tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::stealFront(size_t queue, Task& task) {
+    WorkQueue& q = *queues[queue];
+    lock_guard<mutex> lock(q.mutex);
+    if(q.tasks.empty()) return false;
+    task = q.tasks.front();
+    q.tasks.pop_front();
+    return true;
+}
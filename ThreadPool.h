@@ -0,0 +1,69 @@
+#ifndef AMERICANOPTIONSPRICING_THREADPOOL_H
+#define AMERICANOPTIONSPRICING_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed size work-stealing thread pool. Each worker owns a deque: it pops its own work from the back and steals from the
+ * front of other workers' deques when it runs dry. Callers block in parallelFor but keep executing pool tasks while they
+ * wait, so parallel loops can be nested inside tasks without deadlocking.
+ */
+class ThreadPool {
+public:
+    // Constructor, 0 threads uses one per hardware thread
+    explicit ThreadPool(unsigned int threads = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Getters
+    unsigned int size() const;
+
+    /**
+     * Runs body(i) for every i in [0, count) on the pool and returns once all have finished. An exception thrown by body
+     * does not stop the other iterations, the first one caught is rethrown here once they have all finished.
+     * @param count number of iterations
+     * @param body called once per iteration, possibly concurrently
+     */
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+
+private:
+    // State of one parallelFor, on its caller's stack
+    struct Loop {
+        std::atomic<std::size_t> pending;   // iterations not yet finished
+        std::mutex errorMutex;
+        std::exception_ptr error;           // first exception thrown by an iteration
+    };
+    struct Task {
+        const std::function<void(std::size_t)>* body;
+        std::size_t index;
+        Loop* loop;
+    };
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;     // One per worker
+    std::vector<std::thread> workers;
+    std::atomic<std::size_t> queued;
+    std::atomic<bool> stopping;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+
+    void workerLoop(std::size_t id);
+    bool runOne(std::size_t home);
+    bool popBack(std::size_t queue, Task& task);
+    bool stealFront(std::size_t queue, Task& task);
+};
+
+#endif //AMERICANOPTIONSPRICING_THREADPOOL_H
@@ -0,0 +1,156 @@
+#include "Tracing.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// Words of a span's detail label kept in its event
+static const size_t detailWords = 3;
+
+/**
+ * One span in a ring buffer. Its fields are written under a sequence lock: sequence is 2 * index + 1 while event index
+ * is being written and 2 * index + 2 once complete, so a reader can tell a finished event from one being overwritten.
+ */
+struct TraceEvent {
+    atomic<uint64_t> sequence;
+    atomic<const char*> name;
+    atomic<const char*> category;
+    atomic<uint64_t> detail[detailWords];
+    atomic<int64_t> start;
+    atomic<int64_t> duration;
+};
+
+/**
+ * Ring buffer of the spans of one thread, written by that thread only
+ */
+struct TraceBuffer {
+    explicit TraceBuffer(int tid)
+        : tid(tid), head(0), from(0), events(new TraceEvent[traceBufferEvents]){
+        for(size_t i = 0; i < traceBufferEvents; i++) events[i].sequence.store(0, memory_order_relaxed);
+    }
+
+    int tid;
+    atomic<uint64_t> head;      // events written so far
+    atomic<uint64_t> from;      // first event still to export, moved forward by clearTrace
+    unique_ptr<TraceEvent[]> events;
+};
+
+static atomic<bool> enabled(false);
+static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+// Buffers of every thread that recorded a span, kept for the life of the process so exports can outlive threads
+static mutex registryMutex;
+static vector<unique_ptr<TraceBuffer>> registry;
+static thread_local TraceBuffer* localBuffer = nullptr;
+
+static int64_t now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count();
+}
+
+static TraceBuffer& threadBuffer() {
+    if(!localBuffer){
+        lock_guard<mutex> lock(registryMutex);
+        registry.emplace_back(new TraceBuffer(int(registry.size()) + 1));
+        localBuffer = registry.back().get();
+    }
+    return *localBuffer;
+}
+
+static void record(const char* name, const char* category, const char* detail, int64_t start, int64_t end) {
+    TraceBuffer& buffer = threadBuffer();
+    uint64_t index = buffer.head.load(memory_order_relaxed);
+    TraceEvent& event = buffer.events[index % traceBufferEvents];
+    event.sequence.store(2 * index + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    event.name.store(name, memory_order_relaxed);
+    event.category.store(category, memory_order_relaxed);
+    uint64_t words[detailWords] = {};
+    if(detail) strncpy(reinterpret_cast<char*>(words), detail, sizeof(words) - 1);
+    for(size_t w = 0; w < detailWords; w++) event.detail[w].store(words[w], memory_order_relaxed);
+    event.start.store(start, memory_order_relaxed);
+    event.duration.store(end - start, memory_order_relaxed);
+    event.sequence.store(2 * index + 2, memory_order_release);
+    buffer.head.store(index + 1, memory_order_release);
+}
+
+// Writes s as a JSON string
+static void writeString(ostream& out, const char* s) {
+    out << '"';
+    for(; *s; s++){
+        if(*s == '"' || *s == '\\') out << '\\';
+        if((unsigned char)*s >= 0x20) out << *s;
+    }
+    out << '"';
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category, const char* detail)
+    : name(name), category(category), detail(detail), start(enabled.load(memory_order_relaxed) ? now() : -1){
+}
+
+TraceSpan::~TraceSpan() {
+    if(start >= 0) record(name, category, detail, start, now());
+}
+
+void setTracing(bool on) {
+    enabled.store(on);
+}
+
+bool tracingEnabled() {
+    return enabled.load();
+}
+
+void clearTrace() {
+    lock_guard<mutex> lock(registryMutex);
+    for(auto& buffer: registry) buffer->from.store(buffer->head.load());
+}
+
+size_t writeChromeTrace(ostream& out) {
+    lock_guard<mutex> lock(registryMutex);
+    size_t written = 0;
+    // Timestamps in microseconds, to the nanosecond
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision(3);
+    out.setf(ios::fixed, ios::floatfield);
+    out << "{\"traceEvents\": [";
+    for(auto& buffer: registry){
+        uint64_t head = buffer->head.load(memory_order_acquire);
+        uint64_t first = max(buffer->from.load(), head > traceBufferEvents ? head - traceBufferEvents : 0);
+        for(uint64_t index = first; index < head; index++){
+            TraceEvent& event = buffer->events[index % traceBufferEvents];
+            uint64_t sequence = event.sequence.load(memory_order_acquire);
+            if(sequence != 2 * index + 2) continue;
+            const char* name = event.name.load(memory_order_relaxed);
+            const char* category = event.category.load(memory_order_relaxed);
+            uint64_t words[detailWords];
+            for(size_t w = 0; w < detailWords; w++) words[w] = event.detail[w].load(memory_order_relaxed);
+            int64_t start = event.start.load(memory_order_relaxed);
+            int64_t duration = event.duration.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            // Overwritten by a lap of the ring while being read
+            if(event.sequence.load(memory_order_relaxed) != sequence) continue;
+            out << (written ? ",\n" : "\n") << "{\"name\": ";
+            writeString(out, name);
+            out << ", \"cat\": ";
+            writeString(out, category);
+            out << ", \"ph\": \"X\", \"ts\": " << double(start) / 1e3 << ", \"dur\": " << double(duration) / 1e3
+                << ", \"pid\": 1, \"tid\": " << buffer->tid;
+            const char* detail = reinterpret_cast<const char*>(words);
+            if(*detail){
+                out << ", \"args\": {\"detail\": ";
+                writeString(out, detail);
+                out << "}";
+            }
+            out << "}";
+            written++;
+        }
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+    out.flags(flags);
+    out.precision(precision);
+    return written;
+}
@@ -0,0 +1,49 @@
+#ifndef AMERICANOPTIONSPRICING_TRACING_H
+#define AMERICANOPTIONSPRICING_TRACING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Events each thread keeps, older ones are overwritten
+const std::size_t traceBufferEvents = 1 << 14;
+
+/**
+ * Scoped span recorded as one complete event when it closes. Every thread writes its spans to its own ring buffer
+ * without locking, so spans can sit on hot paths; while tracing is off a span only reads a flag.
+ */
+class TraceSpan {
+public:
+    /**
+     * Opens a span
+     * @param name span name, must outlive the trace, typically a literal
+     * @param category trace event category, as name
+     * @param detail optional label copied into the event, truncated, e.g. a symbol
+     */
+    TraceSpan(const char* name, const char* category, const char* detail = nullptr);
+    ~TraceSpan();
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* category;
+    const char* detail;
+    std::int64_t start;     // nanoseconds since the trace clock started, negative when not recording
+};
+
+// Starts or stops recording spans, for every thread
+void setTracing(bool enabled);
+bool tracingEnabled();
+
+// Drops the spans recorded so far, spans still open are kept when they close
+void clearTrace();
+
+/**
+ * Writes the recorded spans of every thread as Chrome trace-event JSON, for chrome://tracing or Perfetto. Threads keep
+ * recording meanwhile, events overwritten while being read are skipped.
+ * @return spans written
+ */
+std::size_t writeChromeTrace(std::ostream& out);
+
+#endif //AMERICANOPTIONSPRICING_TRACING_H
@@ -0,0 +1,22 @@
+#include "TridiagonalMatrix.h"
+
+using namespace Eigen;
+
+TridiagonalMatrix::TridiagonalMatrix(int n)
+    : lower(VectorXd::Zero(n)), diag(VectorXd::Zero(n)), upper(VectorXd::Zero(n)){
+}
+
+int TridiagonalMatrix::size() const {
+    return int(diag.size());
+}
+
+MatrixXd TridiagonalMatrix::toDense() const {
+    int n = size();
+    MatrixXd M = MatrixXd::Zero(n, n);
+    for(int i = 0; i < n; i++){
+        if(i > 0) M(i, i - 1) = lower(i);
+        M(i, i) = diag(i);
+        if(i < n - 1) M(i, i + 1) = upper(i);
+    }
+    return M;
+}
@@ -0,0 +1,24 @@
+#ifndef AMERICANOPTIONSPRICING_TRIDIAGONALMATRIX_H
+#define AMERICANOPTIONSPRICING_TRIDIAGONALMATRIX_H
+
+#include <Eigen/Eigen>
+
+/**
+ * Banded storage for a square tridiagonal matrix. Each diagonal is kept in its own contiguous vector indexed by row:
+ * lower(i) = M(i, i - 1), diag(i) = M(i, i), upper(i) = M(i, i + 1). lower(0) and upper(n - 1) are unused and kept at 0.
+ */
+class TridiagonalMatrix {
+public:
+    // Constructor
+    explicit TridiagonalMatrix(int n);
+
+    // Getters
+    int size() const;
+    Eigen::MatrixXd toDense() const;      // Expand to a dense matrix, used for debugging
+
+    Eigen::VectorXd lower;
+    Eigen::VectorXd diag;
+    Eigen::VectorXd upper;
+};
+
+#endif //AMERICANOPTIONSPRICING_TRIDIAGONALMATRIX_H
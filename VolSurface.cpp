@@ -0,0 +1,54 @@
+#include "VolSurface.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+
+VolSurface::VolSurface(const vector<double>& strikes, const vector<double>& expiries, const vector<double>& vols)
+    : strikes(strikes), expiries(expiries), vols(vols){
+    assert(!strikes.empty() && !expiries.empty() && "a surface needs at least one quote");
+    assert(vols.size() == strikes.size() * expiries.size() && "one volatility per strike and expiry");
+    assert(is_sorted(strikes.begin(), strikes.end()) && is_sorted(expiries.begin(), expiries.end()));
+}
+
+VolSurface::VolSurface(double vol)
+    : strikes(1, 0.), expiries(1, 0.), vols(1, vol){
+}
+
+const vector<double>& VolSurface::getStrikes() const {
+    return strikes;
+}
+
+const vector<double>& VolSurface::getExpiries() const {
+    return expiries;
+}
+
+/**
+ * Interval of axis holding x and the weight of its upper end, clamped so values beyond either end are held flat
+ */
+static size_t bracket(const vector<double>& axis, const double x, double& weight) {
+    if(axis.size() == 1 || x <= axis.front()){
+        weight = 0.;
+        return 0;
+    }
+    if(x >= axis.back()){
+        weight = 1.;
+        return axis.size() - 2;
+    }
+    size_t j = size_t(upper_bound(axis.begin(), axis.end(), x) - axis.begin()) - 1;
+    weight = (x - axis[j]) / (axis[j + 1] - axis[j]);
+    return j;
+}
+
+double VolSurface::vol(double K, double T) const {
+    double wK, wT;
+    size_t k = bracket(strikes, K, wK);
+    size_t e = bracket(expiries, T, wT);
+    size_t n = strikes.size();
+    // Neighbouring quotes, the same one twice along an axis with a single point
+    size_t k1 = min(k + 1, n - 1);
+    size_t e1 = min(e + 1, expiries.size() - 1);
+    double lower = (1. - wK) * vols[e * n + k] + wK * vols[e * n + k1];
+    double upper = (1. - wK) * vols[e1 * n + k] + wK * vols[e1 * n + k1];
+    return (1. - wT) * lower + wT * upper;
+}
@@ -0,0 +1,36 @@
+#ifndef AMERICANOPTIONSPRICING_VOLSURFACE_H
+#define AMERICANOPTIONSPRICING_VOLSURFACE_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Volatility quoted on a strike x expiry grid, bilinearly interpolated between the quotes and held flat beyond the
+ * outermost strikes and expiries. Depending on the pricing model the same quotes are read as implied volatilities, one
+ * per contract, or as a local volatility in spot, see VolModel.
+ */
+class VolSurface {
+public:
+    /**
+     * Constructor
+     * @param strikes increasing
+     * @param expiries increasing, in years
+     * @param vols vols[e * strikes.size() + k] is the volatility at expiries[e] and strikes[k]
+     */
+    VolSurface(const std::vector<double>& strikes, const std::vector<double>& expiries, const std::vector<double>& vols);
+
+    // Flat surface at a single volatility
+    explicit VolSurface(double vol);
+
+    // Getters
+    const std::vector<double>& getStrikes() const;
+    const std::vector<double>& getExpiries() const;
+    double vol(double K, double T) const;       // Interpolated volatility at strike K and expiry T
+
+private:
+    std::vector<double> strikes;
+    std::vector<double> expiries;
+    std::vector<double> vols;
+};
+
+#endif //AMERICANOPTIONSPRICING_VOLSURFACE_H
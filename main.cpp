@@ -1,9 +1,56 @@
 #include <iostream>
+#include <memory>
 #include "Stock.h"
 #include "Option.h"
+#include "Price_American_PSOR.h"
+#include "ThreadPool.h"
+#include "Tracing.h"
+#include "BatchPricing.h"
+#include "RichardsonPricing.h"
+#include "SolverProfile.h"
+#include "MarketDataPipeline.h"
+#include "VolSurface.h"
+#include "ImpliedVol.h"
+#include "AllocationCounter.h"
+#include "LockstepPSOR.h"
+#include <atomic>
+#include <chrono>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
 
 using namespace std;
 
+// Checks failed so far, main exits with an error when any did
+static int failedChecks = 0;
+
+/**
+ * Prints whether a check passed, counting failures
+ * @param what the property checked, including its tolerance
+ */
+static void check(const string& what, bool passed) {
+    cout << "Check " << what << ": " << (passed ? "pass" : "FAIL") << "\n";
+    if(!passed) failedChecks++;
+}
+
+/**
+ * Queue entry whose copy can be held up, to stall a consumer inside pop between claiming its slot and handing it back
+ */
+struct HeldCopy {
+    int id = 0;
+    atomic<bool>* inCopy = nullptr;     // set on a destination: raised on entering the copy, which then waits for release
+    atomic<bool>* release = nullptr;
+
+    HeldCopy& operator=(const HeldCopy& other) {
+        if(inCopy){
+            inCopy->store(true);
+            while(!release->load()) this_thread::yield();
+        }
+        id = other.id;
+        return *this;
+    }
+};
+
 int main() {
 
     // Initialize stock data
@@ -28,16 +75,349 @@ int main() {
     for(const auto& k: straddle){
         cout << k[0] << " " << k[1] << " " << k[2] << "\n";
     }
+    // Read the same chain through its column views, without allocating
+    size_t allocationsBefore = threadAllocationCount();
+    ChainView view = opAAPL.getChain();
+    bool viewMatches = view.strike.size == straddle.size() && view.callDelta.size == straddle.size();
+    for(size_t i = 0; viewMatches && i < view.strike.size; i++){
+        viewMatches = view.put[i] == straddle[i][0] && view.strike[i] == straddle[i][1] && view.call[i] == straddle[i][2];
+    }
+    size_t viewAllocations = threadAllocationCount() - allocationsBefore;
+    cout << "Chain view matches straddle: " << (viewMatches ? "yes" : "no") << ", allocations " << viewAllocations << "\n";
+    check("chain view matches the straddle without allocating", viewMatches && viewAllocations == 0);
+    // Deep in the money, calls move one for one with the spot and puts sit on their exercise value
+    vector<vector<double>> chainDelta = opAAPL.getDelta(), chainGamma = opAAPL.getGamma();
+    bool deepGreeks = true;
+    for(size_t i = 0; i < straddle.size(); i++){
+        double moneyness = opAAPL.getStockPrice() / straddle[i][1];
+        if(moneyness >= 1.75) deepGreeks = deepGreeks && abs(chainDelta[i][0] - 1.) < .01 && chainGamma[i][0] > -1e-4;
+        if(moneyness <= .7) deepGreeks = deepGreeks && chainDelta[i][1] == -1. && chainGamma[i][1] == 0.;
+    }
+    check("deep in the money call delta within .01 of 1, put delta -1, no negative gamma", deepGreeks);
     // Check price of ITM call and puts
-    double ITMCall =  opAAPL.getCallAtStrike(50.);
-    double ITMPut = opAAPL.getPutAtStrike(50.);
+    double ITMCall = 0., ITMPut = 0.;
+    opAAPL.getCallAtStrike(50., ITMCall);
+    opAAPL.getPutAtStrike(50., ITMPut);
     cout << "ITM calls are trading at $" << ITMCall << "\n";
     cout << "ITM puts are trading at $" << ITMPut << "\n";
-    // Test edge cases
-    double badITMCall =  opAAPL.getCallAtStrike(50.1);
-    double badITMPut = opAAPL.getPutAtStrike(50.1);
-    cout << "Bad ITM calls are not trading at $" << badITMCall << "\n";
-    cout << "Bad ITM puts are not trading at $" << badITMPut << "\n";
+    // Test edge cases, strikes off the chain are read off its grid and strikes off the grid have no price
+    double offCall = 0., offPut = 0., farCall = 0.;
+    bool offChain = opAAPL.getCallAtStrike(50.1, offCall) == StrikeStatus::OffChain
+                    && opAAPL.getPutAtStrike(50.1, offPut) == StrikeStatus::OffChain;
+    cout << "Off-chain calls " << (offChain ? "are priced" : "are not priced") << " at $" << offCall << "\n";
+    cout << "Off-chain puts " << (offChain ? "are priced" : "are not priced") << " at $" << offPut << "\n";
+    bool farOut = opAAPL.getCallAtStrike(5., farCall) == StrikeStatus::OutOfRange;
+    cout << "Strike 5 is " << (farOut ? "" : "not ") << "out of range\n";
+    // Prices fall with strike for calls and rise for puts, so 50.1 sits between the listed 50 and 51
+    double call51 = 0., put51 = 0.;
+    bool between = opAAPL.getCallAtStrike(51., call51) == StrikeStatus::Listed
+                   && opAAPL.getPutAtStrike(51., put51) == StrikeStatus::Listed
+                   && offCall <= ITMCall && offCall >= call51 && offPut >= ITMPut && offPut <= put51;
+    check("strike 50.1 priced off the chain between the listed 50 and 51, strike 5 out of range",
+          offChain && between && farOut);
+    // Bulk lookup of the listed strikes and halfway between them
+    vector<double> lookupStrikes, lookupPrices;
+    for(const auto& k: straddle){
+        lookupStrikes.push_back(k[1]);
+        lookupStrikes.push_back(k[1] + .25);
+    }
+    lookupPrices.resize(lookupStrikes.size());
+    unique_ptr<StrikeStatus[]> lookupStatus(new StrikeStatus[lookupStrikes.size()]);
+    opAAPL.getPutsAtStrikes(lookupStrikes.data(), lookupStrikes.size(), lookupPrices.data(), lookupStatus.get());
+    size_t listed = count(lookupStatus.get(), lookupStatus.get() + lookupStrikes.size(), StrikeStatus::Listed);
+    bool monotone = is_sorted(lookupPrices.begin(), lookupPrices.end());
+    cout << "Bulk lookup: " << listed << " of " << lookupStrikes.size() << " strikes listed, puts rise with strike: "
+         << (monotone ? "yes" : "no") << "\n";
+    check("bulk lookup finds every listed strike and puts rise with strike", listed == straddle.size() && monotone);
+    // Check Brennan-Schwartz and red-black PSOR agree with PSOR across the strike chain
+    double maxSolverDiff = 0., maxRedBlackDiff = 0.;
+    for(const auto& k: straddle){
+        for(bool type: {true, false}){
+            double psor = priceAmericanPSOR(opAAPL.getStockPrice(), opAAPL.getDTE(), opAAPL.getVolatility(), k[1], 0.05, type);
+            double bs = priceAmericanPSOR(opAAPL.getStockPrice(), opAAPL.getDTE(), opAAPL.getVolatility(), k[1], 0.05, type,
+                                          PSORSolver::BrennanSchwartz);
+            double rb = priceAmericanPSOR(opAAPL.getStockPrice(), opAAPL.getDTE(), opAAPL.getVolatility(), k[1], 0.05, type,
+                                          PSORSolver::RedBlackPSOR);
+            maxSolverDiff = max(maxSolverDiff, abs(psor - bs));
+            maxRedBlackDiff = max(maxRedBlackDiff, abs(psor - rb));
+        }
+    }
+    cout << "Max PSOR vs Brennan-Schwartz difference $" << maxSolverDiff << "\n";
+    check("PSOR within $0.002 of Brennan-Schwartz across the chain", maxSolverDiff < 2e-3);
+    cout << "Max PSOR vs red-black PSOR difference $" << maxRedBlackDiff << "\n";
+    check("red-black PSOR within $0.002 of PSOR across the chain", maxRedBlackDiff < 2e-3);
+    // Report how hard PSOR worked with the automatically chosen relaxation factor
+    SolverStats stats;
+    priceAmericanPSORGreeks(opAAPL.getStockPrice(), opAAPL.getDTE(), opAAPL.getVolatility(), 230., 0.05, false,
+                            PSORSolver::PSOR, nullptr, &stats);
+    cout << "PSOR sweeps per step: " << double(stats.totalIterations) / stats.steps << " average, "
+         << stats.maxIterations << " max, final weight " << stats.weight << ", " << stats.nonConverged
+         << " steps short of the tolerance\n";
+    // Compare a sinh grid with a uniform grid of twice the nodes against a fine reference, near the money
+    PricingConfig fine, uniformGrid, sinhGrid;
+    fine.nodes = 2000;
+    uniformGrid.nodes = 2 * gridNodes;
+    sinhGrid.spacing = GridSpacing::Sinh;
+    // Converge PSOR tightly so only the grids differ
+    uniformGrid.tolerance = sinhGrid.tolerance = 1e-10;
+    double maxUniformErr = 0., maxSinhErr = 0.;
+    for(double k = .8 * AAPL.getPrice(); k <= 1.2 * AAPL.getPrice(); k += .05 * AAPL.getPrice()){
+        double ref = priceAmericanPSOR(AAPL.getPrice(), 1., AAPL.getVolatility(), k, 0.05, false,
+                                       PSORSolver::BrennanSchwartz, nullptr, fine);
+        double uniform = priceAmericanPSOR(AAPL.getPrice(), 1., AAPL.getVolatility(), k, 0.05, false, PSORSolver::PSOR,
+                                           nullptr, uniformGrid);
+        double sinh = priceAmericanPSOR(AAPL.getPrice(), 1., AAPL.getVolatility(), k, 0.05, false, PSORSolver::PSOR,
+                                        nullptr, sinhGrid);
+        maxUniformErr = max(maxUniformErr, abs(uniform - ref));
+        maxSinhErr = max(maxSinhErr, abs(sinh - ref));
+    }
+    cout << "Max near the money put error, " << uniformGrid.nodes << " uniform nodes $" << maxUniformErr << ", "
+         << sinhGrid.nodes << " sinh nodes $" << maxSinhErr << "\n";
+    check("100 node sinh grid at least as accurate near the money as 200 uniform nodes", maxSinhErr <= maxUniformErr);
+    // Check pooled chain pricing is identical to serial pricing
+    ThreadPool pool(4);
+    vector<Stock> universe = {AAPL, Stock("MSFT", 415., .24), Stock("F", 11.5, .35)};
+    // Trace building the universe, the spans export as Chrome trace-event JSON for chrome://tracing
+    setTracing(true);
+    vector<Option> chains = priceOptionChains(universe, 1., false, pool);
+    setTracing(false);
+    stringstream trace;
+    size_t spans = writeChromeTrace(trace);
+    cout << "Traced " << spans << " spans, call chains traced: "
+         << (trace.str().find("\"setCallChain\"") != string::npos ? "yes" : "no") << "\n";
+    bool pooledMatches = chains.size() == universe.size();
+    for(size_t i = 0; pooledMatches && i < universe.size(); i++){
+        Option serial(universe[i].getSymbol(), universe[i].getPrice(), 1., universe[i].getVolatility(), false);
+        pooledMatches = chains[i].getOptionChain() == serial.getOptionChain();
+    }
+    cout << "Pooled chains match serial chains: " << (pooledMatches ? "yes" : "no") << "\n";
+    check("chains priced on the pool identical to serially built ones, AAPL's to the straddle",
+          pooledMatches && chains[0].getOptionChain() == straddle);
+    // An iteration throwing on a worker reaches the caller once the others have finished
+    atomic<int> iterationsRun(0);
+    bool rethrown = false;
+    try{
+        pool.parallelFor(16, [&iterationsRun](size_t i){
+            iterationsRun++;
+            if(i == 5) throw runtime_error("iteration 5");
+        });
+    }
+    catch(const runtime_error& error){
+        rethrown = string(error.what()) == "iteration 5";
+    }
+    check("exception thrown in a pooled iteration rethrown on the caller after every iteration ran",
+          rethrown && iterationsRun == 16);
+    // Move a spot inside its strike chain, repricing off the cached grids, and check against a fresh solve
+    Option& msft = chains[1];
+    bool trustedMove = msft.isTrustedSpot(420.);
+    cout << "Spot move to 420 repriced without a solve: " << (trustedMove ? "yes" : "no") << "\n";
+    msft.setStockPrice(420.);
+    vector<vector<double>> movedStraddle = msft.getOptionChain();
+    vector<double> movedStrikes, freshCalls;
+    for(const auto& k: movedStraddle) movedStrikes.push_back(k[1]);
+    priceAmericanChainPSOR(420., 1., .24, movedStrikes, 0.05, true, freshCalls);
+    double maxMoveDiff = 0.;
+    for(size_t i = 0; i < movedStrikes.size(); i++) maxMoveDiff = max(maxMoveDiff, abs(movedStraddle[i][2] - freshCalls[i]));
+    cout << "Max repriced vs solved call difference $" << maxMoveDiff << "\n";
+    check("spot move repriced off the cached grids, within $1e-9 of a new solve", trustedMove && maxMoveDiff < 1e-9);
+    // Replay a burst of ticks through the ingest pipeline, chains end up priced at the last quote of their stock
+    vector<Stock> live = {Stock("AAPL", 199., .21), Stock("MSFT", 415., .24), Stock("F", 11.5, .35)};
+    vector<Option> liveChains;
+    for(const auto& stock: live) liveChains.emplace_back(stock.getSymbol(), stock.getPrice(), 1., stock.getVolatility(), false);
+    stringstream tape;
+    for(int i = 1; i <= 300; i++){
+        tape << "AAPL " << 199. + .01 * i << "\nMSFT " << 415. - .02 * i << "\n";
+        if(i % 100 == 0) tape << "F " << 11.5 + .01 * i << " .3\n";
+    }
+    tape << "# end of session\nTSLA 250.\n";
+    size_t published;
+    IngestStats ingestStats;
+    {
+        MarketDataPipeline pipeline(live, 2);
+        for(auto& chain: liveChains) pipeline.subscribe(chain);
+        published = pipeline.ingest(tape);
+        pipeline.close();
+        ingestStats = pipeline.stats();
+    }
+    bool atLastQuote = true;
+    for(size_t i = 0; i < live.size(); i++){
+        vector<vector<double>> liveStraddle = liveChains[i].getOptionChain();
+        vector<double> liveStrikes, freshPuts;
+        for(const auto& k: liveStraddle) liveStrikes.push_back(k[1]);
+        priceAmericanChainPSOR(live[i].getPrice(), 1., live[i].getVolatility(), liveStrikes, 0.05, false, freshPuts);
+        atLastQuote = atLastQuote && liveChains[i].getStockPrice() == live[i].getPrice();
+        for(size_t k = 0; k < liveStrikes.size(); k++) atLastQuote = atLastQuote && liveStraddle[k][0] == freshPuts[k];
+    }
+    // Hundreds of ticks land during each reprice, far more than the consumers can apply one by one
+    bool coalesced = ingestStats.updates < ingestStats.ticks;
+    cout << "Ingested " << published << " ticks, " << ingestStats.rejected << " rejected, " << ingestStats.updates
+         << " applied, chains at the last quote: " << (atLastQuote ? "yes" : "no") << "\n";
+    check("tick burst coalesced, 603 ticks published, the unknown symbol rejected, chains at the last quote",
+          coalesced && published == 603 && ingestStats.rejected == 1 && atLastQuote);
+    // Destroying the pipeline unsubscribes its chains, later changes to the stock reach neither chain
+    {
+        vector<Stock> held = {Stock("F", 11.5, .35)};
+        Option kept("F", 11.5, 1., .35, false);
+        {
+            Option dropped("F", 11.5, 1., .35, false);
+            MarketDataPipeline pipeline(held);
+            pipeline.subscribe(kept);
+            pipeline.subscribe(dropped);
+        }
+        held[0].setPrice(12.);
+        check("stock changed after its pipeline is gone leaves the chains it fed alone", kept.getStockPrice() == 11.5);
+    }
+    // A consumer stalled inside pop still holds its slot, the producer's push a lap later must wait for it
+    {
+        SPMCQueue<HeldCopy> ring(2);
+        atomic<bool> inCopy(false), release(false);
+        ring.push(HeldCopy{1});
+        ring.push(HeldCopy{2});
+        HeldCopy first, second, third;
+        first.inCopy = &inCopy;
+        first.release = &release;
+        thread stalled([&]{ ring.pop(first); });
+        while(!inCopy.load()) this_thread::yield();
+        bool popped = ring.pop(second);
+        bool slotHeld = !ring.push(HeldCopy{3});
+        thread releaser([&]{
+            this_thread::sleep_for(chrono::milliseconds(10));
+            release.store(true);
+        });
+        ring.pushWait(HeldCopy{3});
+        stalled.join();
+        releaser.join();
+        popped = popped && ring.pop(third) && ring.empty();
+        check("push behind a consumer stalled inside pop waits for the slot",
+              popped && slotHeld && first.id == 1 && second.id == 2 && third.id == 3);
+    }
+    // Check batch pricing matches the chain
+    size_t nStrikes = straddle.size();
+    vector<double> spots(nStrikes, opAAPL.getStockPrice()), expiries(nStrikes, opAAPL.getDTE());
+    vector<double> vols(nStrikes, opAAPL.getVolatility()), rates(nStrikes, 0.05), strikes, batchPrices(nStrikes);
+    for(const auto& k: straddle) strikes.push_back(k[1]);
+    unique_ptr<bool[]> callTypes(new bool[nStrikes]);
+    fill(callTypes.get(), callTypes.get() + nStrikes, true);
+    ContractBatch batch = {nStrikes, spots.data(), expiries.data(), vols.data(), strikes.data(), rates.data(), callTypes.get()};
+    priceAmericanBatch(batch, {batchPrices.data(), nullptr, nullptr, nullptr});
+    double maxBatchDiff = 0.;
+    for(size_t i = 0; i < nStrikes; i++) maxBatchDiff = max(maxBatchDiff, abs(batchPrices[i] - straddle[i][2]));
+    cout << "Max batch vs chain call difference $" << maxBatchDiff << "\n";
+    check("batch priced through the lockstep kernels within $1e-9 of the chain", maxBatchDiff < 1e-9);
+    // Force each lockstep kernel this CPU has and check it against the scalar solver, lane by lane, local vol included
+    {
+        VolSurface smile({30., 45., 60.}, {.5, 1.}, {.3, .22, .18, .28, .21, .18});
+        vector<LockstepGrid> grids;
+        for(int i = 0; i < 11; i++){
+            grids.push_back(LockstepGrid{.25 + .1 * i, .2, .01 * i, i % 2 == 1, i % 3 == 0 ? 1. : 40. + i,
+                                         i % 2 == 1 ? &smile : nullptr});
+        }
+        auto solveAt = [&grids](int width, vector<unique_ptr<PSORWorkspace>>& solved){
+            vector<PSORWorkspace*> lanes;
+            for(size_t g = 0; g < grids.size(); g++){
+                solved.emplace_back(new PSORWorkspace(gridNodes));
+                lanes.push_back(solved.back().get());
+            }
+            setLockstepWidthLimit(width);
+            solveNormalizedGridsLockstep(lanes.data(), grids.data(), grids.size());
+        };
+        vector<unique_ptr<PSORWorkspace>> scalar;
+        solveAt(1, scalar);
+        bool kernelsMatch = true;
+        cout << "Lockstep kernels matching the scalar solver:";
+        for(int width: {4, 8}){
+            setLockstepWidthLimit(width);
+            if(lockstepWidth() != width) continue;
+            vector<unique_ptr<PSORWorkspace>> packed;
+            solveAt(width, packed);
+            bool matches = true;
+            for(size_t g = 0; g < grids.size(); g++){
+                const PSORWorkspace& a = *scalar[g];
+                const PSORWorkspace& b = *packed[g];
+                matches = matches && a.v == b.v && a.vPrev == b.vPrev && a.stats.stepIterations == b.stats.stepIterations
+                          && a.stats.weight == b.stats.weight && a.stats.maxResidual == b.stats.maxResidual
+                          && a.stats.nonConverged == b.stats.nonConverged;
+            }
+            cout << (width == 8 ? " avx512 " : " avx2 ") << (matches ? "yes" : "no");
+            kernelsMatch = kernelsMatch && matches;
+        }
+        cout << "\n";
+        setLockstepWidthLimit(0);
+        check("every lockstep kernel the CPU supports bit-identical to the scalar solver", kernelsMatch);
+    }
+    // Profile the batch on a sweep budget too small to converge, the starved steps show up in the profile
+    PricingConfig starved;
+    starved.maxIter = 3;
+    SolverProfile batchProfile;
+    priceAmericanBatch(batch, {batchPrices.data(), nullptr, nullptr, nullptr}, PSORSolver::PSOR, starved, &batchProfile);
+    batchProfile.dump(cout);
+    // A flat surface prices like the scalar volatility, a skewed one lifts the low strike puts
+    Option flatAAPL("AAPL", opAAPL.getStockPrice(), opAAPL.getDTE(), VolSurface(opAAPL.getVolatility()),
+                    VolModel::Implied, false);
+    double maxFlatDiff = 0.;
+    for(size_t i = 0; i < nStrikes; i++){
+        maxFlatDiff = max(maxFlatDiff, abs(flatAAPL.getChain().put[i] - straddle[i][0]));
+    }
+    cout << "Max flat surface vs scalar volatility put difference $" << maxFlatDiff << "\n";
+    check("flat surface prices the chain within $1e-12 of its scalar volatility", maxFlatDiff < 1e-12);
+    VolSurface skew({.8 * AAPL.getPrice(), AAPL.getPrice(), 1.2 * AAPL.getPrice()}, {.5, 1.},
+                    {.30, .22, .18, .28, .21, .18});
+    vector<PricingResult> impliedPuts, localPuts;
+    vector<double> skewStrikes = {.9 * AAPL.getPrice(), AAPL.getPrice(), 1.1 * AAPL.getPrice()};
+    priceAmericanChainSurface(AAPL.getPrice(), 1., skew, skewStrikes, 0.05, false, impliedPuts, VolModel::Implied);
+    priceAmericanChainSurface(AAPL.getPrice(), 1., skew, skewStrikes, 0.05, false, localPuts, VolModel::Local);
+    cout << "Skewed puts (implied, local):";
+    for(size_t k = 0; k < skewStrikes.size(); k++){
+        cout << " K " << skewStrikes[k] << " $" << impliedPuts[k].price << " $" << localPuts[k].price << ";";
+    }
+    cout << "\n";
+    // Back out the volatility of a put chain priced at 25%, warm-started strike to strike and cold from the guess
+    vector<double> ivStrikes, ivPrices;
+    for(double m = .7; m < 1.31; m += .05) ivStrikes.push_back(m * AAPL.getPrice());
+    for(double K: ivStrikes){
+        ivPrices.push_back(priceAmericanPSOR(AAPL.getPrice(), 1., .25, K, 0.05, false, PSORSolver::BrennanSchwartz));
+    }
+    vector<ImpliedVolResult> warm;
+    impliedVolChainAmerican(ivPrices, AAPL.getPrice(), 1., ivStrikes, 0.05, false, warm);
+    double maxVolErr = 0.;
+    int warmSolves = 0, coldSolves = 0;
+    for(size_t k = 0; k < ivStrikes.size(); k++){
+        maxVolErr = max(maxVolErr, abs(warm[k].vol - .25));
+        warmSolves += warm[k].solves;
+        coldSolves += impliedVolAmerican(ivPrices[k], AAPL.getPrice(), 1., ivStrikes[k], 0.05, false).solves;
+    }
+    cout << "Implied volatility of " << ivStrikes.size() << " puts, max error " << maxVolErr << ", solves per strike "
+         << double(warmSolves) / ivStrikes.size() << " warm, " << double(coldSolves) / ivStrikes.size() << " cold\n";
+    ImpliedVolResult belowIntrinsic = impliedVolAmerican(10., AAPL.getPrice(), 1., AAPL.getPrice() + 20., 0.05, false);
+    cout << "Put quoted below intrinsic is below bound: "
+         << (belowIntrinsic.status == ImpliedVolStatus::BelowBound ? "yes" : "no") << "\n";
+    bool allConverged = true;
+    for(const ImpliedVolResult& result: warm) allConverged = allConverged && result.status == ImpliedVolStatus::Converged;
+    check("implied volatility within 1e-5 of 25%, warm start at most 3 solves per strike and fewer than cold",
+          allConverged && maxVolErr < 1e-5 && warmSolves <= 3 * int(ivStrikes.size()) && warmSolves < coldSolves);
+    check("put quoted below intrinsic is below bound", belowIntrinsic.status == ImpliedVolStatus::BelowBound);
+    // Richardson-extrapolate three coarse grids solved on the pool, against a fine grid with matching time steps
+    PricingConfig coarse, fineSteps = fine;
+    coarse.nodes = coarse.timeSteps = 50;
+    coarse.tolerance = 1e-10;
+    fineSteps.timeSteps = fineSteps.nodes;
+    bool richardsonCloser = true;
+    for(bool type: {false, true}){
+        double atmRef = priceAmericanPSOR(AAPL.getPrice(), 1., AAPL.getVolatility(), AAPL.getPrice(), 0.05, type,
+                                          PSORSolver::BrennanSchwartz, nullptr, fineSteps);
+        PricingResult extrapolated = priceAmericanRichardson(AAPL.getPrice(), 1., AAPL.getVolatility(), AAPL.getPrice(),
+                                                             0.05, type, 3, PSORSolver::PSOR, &pool, coarse);
+        double single = priceAmericanPSOR(AAPL.getPrice(), 1., AAPL.getVolatility(), AAPL.getPrice(), 0.05, type,
+                                          PSORSolver::PSOR, nullptr, coarse);
+        cout << "At the money " << (type ? "call" : "put") << " error, 50 node grid $" << abs(single - atmRef)
+             << ", Richardson over 50, 100 and 200 $" << abs(extrapolated.price - atmRef) << "\n";
+        richardsonCloser = richardsonCloser && abs(extrapolated.price - atmRef) < abs(single - atmRef);
+    }
+    // Deep in the money the extrapolated call stays on its European lower bound, above its exercise value
+    PricingResult deepCall = priceAmericanRichardson(AAPL.getPrice(), 1., AAPL.getVolatility(), .5 * AAPL.getPrice(),
+                                                     0.05, true, 3, PSORSolver::PSOR, &pool, coarse);
+    check("Richardson closer than its coarsest grid to the at the money put and call, deep call above S - K e^(-rT)",
+          richardsonCloser && deepCall.price >= AAPL.getPrice() - .5 * AAPL.getPrice() * exp(-0.05));
     // Compute option greeks
     vector<vector<double>> delta = opAAPL.getDelta();
     vector<vector<double>> gamma = opAAPL.getGamma();
@@ -49,5 +429,14 @@ int main() {
     for(const auto& i: gamma){
         cout << i[0] << " " << i[1] << "\n";
     }
+    vector<vector<double>> theta = opAAPL.getTheta();
+    cout << "___Theta___\n";
+    for(const auto& i: theta){
+        cout << i[0] << " " << i[1] << "\n";
+    }
+    if(failedChecks > 0){
+        cout << failedChecks << " checks failed\n";
+        return 1;
+    }
     return 0;
 }